@@ -0,0 +1,83 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+//Compares the per-table hash modes: the fast polynomial hash of ht_new() against SipHash-1-3 from ht_new_seeded().
+//Build: gcc -O2 -pthread -o bench_hash bench_hash.c hash_table.c prime.c siphash.c instrument.c cuckoo.c hopscotch.c
+//       timer_wheel.c thread_pool.c slots.c placement.c sketch.c -lm
+//Usage: ./bench_hash [number of keys]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hash_table.h"
+
+#define BENCH_DEFAULT_KEYS 1000000
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//inserts every key, looks every key up, then looks up as many keys that are not there
+static void bench_table(const char* name, ht_hash_table* ht, char** keys, char** missing, const int n) {
+    double start = now_seconds();
+    for (int i = 0; i < n; i++) {
+        ht_insert(ht, keys[i], "value");
+    }
+    const double insert_time = now_seconds() - start;
+
+    start = now_seconds();
+    int found = 0;
+    for (int i = 0; i < n; i++) {
+        found += ht_search(ht, keys[i]) != NULL;
+    }
+    const double hit_time = now_seconds() - start;
+
+    start = now_seconds();
+    for (int i = 0; i < n; i++) {
+        found += ht_search(ht, missing[i]) != NULL;
+    }
+    const double miss_time = now_seconds() - start;
+
+    printf("%-8s insert %7.1f ns/op   hit %7.1f ns/op   miss %7.1f ns/op   (found %d)\n", name,
+           insert_time * 1e9 / n, hit_time * 1e9 / n, miss_time * 1e9 / n, found);
+    ht_delete_hash_table(ht);
+}
+
+int main(int argc, char** argv) {
+    const int n = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_KEYS;
+    char** keys = malloc(sizeof(char*) * n);
+    char** missing = malloc(sizeof(char*) * n);
+    for (int i = 0; i < n; i++) {
+        keys[i] = malloc(32);
+        missing[i] = malloc(32);
+        snprintf(keys[i], 32, "user:%d:session", i);
+        snprintf(missing[i], 32, "user:%d:absent", i);
+    }
+
+    bench_table("fast", ht_new(), keys, missing, n);
+    bench_table("siphash", ht_new_seeded(), keys, missing, n);
+
+    for (int i = 0; i < n; i++) {
+        free(keys[i]);
+        free(missing[i]);
+    }
+    free(keys);
+    free(missing);
+    return 0;
+}
@@ -0,0 +1,178 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#define _GNU_SOURCE //pthread_setaffinity_np
+
+//Lookup throughput of a table read from every NUMA node, for the three placements: slots first touched on node 0
+//(the default, half the lookups remote on two sockets), slots interleaved over all nodes, and one replica per node
+//(replica.h). Reader threads are spread evenly over the nodes, which takes libnuma; built without it they are pinned
+//to CPUs 0, 1, 2... and the node split is up to the CPU numbering.
+//Build: gcc -O2 -pthread -DHT_HAVE_LIBNUMA -o bench_numa bench_numa.c replica.c placement.c slots.c hash_table.c
+//       prime.c siphash.c instrument.c cuckoo.c hopscotch.c timer_wheel.c thread_pool.c sketch.c -lm -lnuma
+//Usage: ./bench_numa [threads] [seconds per run] [keys]
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HT_HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+#include "hash_table.h"
+#include "hash_table_internal.h"
+#include "placement.h"
+#include "replica.h"
+
+typedef struct {
+    int id;
+    int keys;
+    double seconds;
+    ht_hash_table* ht; //read with ht_search_shared, NULL when the run reads replicated instead
+    ht_replicated* replicated;
+    unsigned long long ops;
+} bench_reader;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//key:<k> without going through snprintf, which would cost about as much as the lookup being measured
+static void format_key(char* out, unsigned k) {
+    char digits[16];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + k % 10);
+        k /= 10;
+    } while (k > 0);
+    memcpy(out, "key:", 4);
+    for (int i = 0; i < n; i++) {
+        out[4 + i] = digits[n - 1 - i];
+    }
+    out[4 + n] = '\0';
+}
+
+//moves the calling thread onto the node or CPU reader number id gets
+static void bench_pin(const int id) {
+#ifdef HT_HAVE_LIBNUMA
+    if (numa_available() >= 0) {
+        numa_run_on_node(id % (numa_max_node() + 1));
+        return;
+    }
+#endif
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(id % (int)sysconf(_SC_NPROCESSORS_ONLN), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static void* bench_reader_run(void* arg) {
+    bench_reader* b = arg;
+    bench_pin(b->id);
+    unsigned seed = (unsigned)b->id * 2654435761u + 1;
+    char key[32];
+    char value[64];
+    unsigned long long found = 0;
+    const double end = now_seconds() + b->seconds;
+    while (now_seconds() < end) {
+        for (int i = 0; i < 1024; i++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            format_key(key, seed % (unsigned)b->keys);
+            if (b->ht != NULL) {
+                found += ht_search_shared(b->ht, key) != NULL;
+            } else {
+                found += ht_replicated_search(b->replicated, key, value, sizeof(value)) >= 0;
+            }
+        }
+        b->ops += 1024;
+    }
+    if (found < b->ops) {
+        fprintf(stderr, "bench_numa: %llu of %llu lookups missed\n", b->ops - found, b->ops);
+    }
+    return NULL;
+}
+
+//lookups per second over threads readers
+static double bench_run(const int threads, const double seconds, const int keys, ht_hash_table* ht,
+                        ht_replicated* replicated) {
+    bench_reader* b = calloc((size_t)threads, sizeof(bench_reader));
+    pthread_t* tids = malloc(sizeof(pthread_t) * (size_t)threads);
+    const double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        b[i] = (bench_reader){i, keys, seconds, ht, replicated, 0};
+        pthread_create(&tids[i], NULL, bench_reader_run, &b[i]);
+    }
+    unsigned long long ops = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        ops += b[i].ops;
+    }
+    const double elapsed = now_seconds() - start;
+    free(b);
+    free(tids);
+    return ops / elapsed;
+}
+
+static ht_hash_table* bench_table(const int keys, const int numa) {
+    ht_hash_table* ht = ht_new();
+    ht_set_numa(ht, numa);
+    ht_reserve(ht, keys);
+    char key[32];
+    for (int k = 0; k < keys; k++) {
+        format_key(key, (unsigned)k);
+        ht_insert(ht, key, "bench-value-0123456789");
+    }
+    return ht;
+}
+
+int main(int argc, char** argv) {
+    const int threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const double seconds = argc > 2 ? atof(argv[2]) : 3;
+    const int keys = argc > 3 ? atoi(argv[3]) : 4000000;
+    int nodes[HT_NUMA_MAX_NODES];
+    printf("%d NUMA nodes, %d readers, %d keys\n", ht_numa_nodes(nodes, HT_NUMA_MAX_NODES), threads, keys);
+    bench_pin(0); //the single tables are built from node 0
+
+    ht_hash_table* ht = bench_table(keys, HT_NUMA_ANY);
+    const double local = bench_run(threads, seconds, keys, ht, NULL);
+    printf("first touch  %12.0f lookups/s\n", local);
+    ht_delete_hash_table(ht);
+
+    ht = bench_table(keys, HT_NUMA_INTERLEAVE);
+    const double interleaved = bench_run(threads, seconds, keys, ht, NULL);
+    printf("interleaved  %12.0f lookups/s  %5.2fx\n", interleaved, interleaved / local);
+    ht_delete_hash_table(ht);
+
+    ht_replicated* replicated = ht_replicated_new();
+    char key[32];
+    for (int k = 0; k < keys; k++) {
+        format_key(key, (unsigned)k);
+        ht_replicated_insert(replicated, key, "bench-value-0123456789");
+    }
+    const double replicas = bench_run(threads, seconds, keys, NULL, replicated);
+    printf("replicated   %12.0f lookups/s  %5.2fx  (%d replicas)\n", replicas, replicas / local,
+           ht_replicated_replicas(replicated));
+    ht_replicated_free(replicated);
+    return 0;
+}
@@ -0,0 +1,194 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+//Scaling of the thread-per-core server in shard.h: for 1, 2, 4... up to n cores it starts the server in process,
+//drives it with pipelined clients over a Unix socket, a fixed number of connections per core, and reports the rate
+//against the single core run. The clients need CPUs of their own, so on a machine with c CPUs run it up to c/2 cores
+//for numbers that measure the server rather than the scheduler.
+//Build: gcc -O2 -pthread -o bench_shard bench_shard.c shard.c server.c hash_table.c prime.c siphash.c instrument.c
+//       cuckoo.c hopscotch.c timer_wheel.c thread_pool.c slots.c placement.c sketch.c -lm
+//Usage: ./bench_shard [max cores] [seconds per run] [connections per core] [pipeline depth] [keys]
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "shard.h"
+
+#define BENCH_SOCKET "/tmp/bench_shard.sock"
+
+typedef struct {
+    int depth;
+    int keys;
+    double seconds;
+    unsigned seed;
+    unsigned long long ops;
+} bench_client;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_unix(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror(path);
+        exit(1);
+    }
+    return fd;
+}
+
+static void write_all(const int fd, const char* data, size_t len) {
+    while (len > 0) {
+        const ssize_t n = write(fd, data, len);
+        if (n <= 0) {
+            perror("write");
+            exit(1);
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+//reads until count whole responses are in
+static void read_responses(const int fd, ht_buf* in, int count) {
+    size_t off = 0;
+    while (count > 0) {
+        if (in->len - off >= sizeof(ht_response_header)) {
+            ht_response_header header;
+            memcpy(&header, in->data + off, sizeof(header));
+            if (in->len - off >= sizeof(header) + header.value_len) {
+                off += sizeof(header) + header.value_len;
+                count--;
+                continue;
+            }
+        }
+        ht_buf_reserve(in, 65536);
+        const ssize_t n = read(fd, in->data + in->len, in->cap - in->len);
+        if (n <= 0) {
+            perror("read");
+            exit(1);
+        }
+        in->len += (size_t)n;
+    }
+    ht_buf_consume(in, off);
+}
+
+//keeps depth requests in flight, 90% GETs and 10% SETs over the key space
+static void* bench_client_run(void* arg) {
+    bench_client* c = arg;
+    const int fd = connect_unix(BENCH_SOCKET);
+    ht_buf out = {NULL, 0, 0};
+    ht_buf in = {NULL, 0, 0};
+    char key[32];
+    const char* value = "bench-value-0123456789";
+    const double end = now_seconds() + c->seconds;
+    while (now_seconds() < end) {
+        for (int i = 0; i < c->depth; i++) {
+            const int k = (int)(rand_r(&c->seed) % (unsigned)c->keys);
+            const int is_set = rand_r(&c->seed) % 10 == 0;
+            const int key_len = snprintf(key, sizeof(key), "key:%d", k);
+            ht_request_header header = {is_set ? HT_OP_SET : HT_OP_GET, 0, (uint16_t)key_len,
+                                        is_set ? (uint32_t)strlen(value) : 0};
+            ht_buf_append(&out, &header, sizeof(header));
+            ht_buf_append(&out, key, (size_t)key_len);
+            if (is_set) {
+                ht_buf_append(&out, value, strlen(value));
+            }
+        }
+        write_all(fd, out.data, out.len);
+        out.len = 0;
+        read_responses(fd, &in, c->depth);
+        c->ops += (unsigned long long)c->depth;
+    }
+    close(fd);
+    ht_buf_free(&out);
+    ht_buf_free(&in);
+    return NULL;
+}
+
+static void* bench_server_run(void* arg) {
+    ht_shard_server_run(arg);
+    return NULL;
+}
+
+//ops per second with the server on cores cores
+static double bench_cores(const int cores, const double seconds, const int per_core, const int depth, const int keys) {
+    ht_shard_server* server = ht_shard_server_new(cores);
+    if (server == NULL || ht_shard_server_listen_unix(server, BENCH_SOCKET) < 0) {
+        perror("bench_shard");
+        exit(1);
+    }
+    pthread_t server_thread;
+    pthread_create(&server_thread, NULL, bench_server_run, server);
+    const int clients = cores * per_core;
+    bench_client* c = calloc((size_t)clients, sizeof(bench_client));
+    pthread_t* tids = malloc(sizeof(pthread_t) * (size_t)clients);
+    const double start = now_seconds();
+    for (int i = 0; i < clients; i++) {
+        c[i] = (bench_client){depth, keys, seconds, (unsigned)i * 7919u + 1, 0};
+        pthread_create(&tids[i], NULL, bench_client_run, &c[i]);
+    }
+    unsigned long long ops = 0;
+    for (int i = 0; i < clients; i++) {
+        pthread_join(tids[i], NULL);
+        ops += c[i].ops;
+    }
+    const double elapsed = now_seconds() - start;
+    ht_shard_server_stop(server);
+    pthread_join(server_thread, NULL);
+    ht_shard_server_free(server);
+    free(c);
+    free(tids);
+    return ops / elapsed;
+}
+
+int main(int argc, char** argv) {
+    const int max_cores = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const double seconds = argc > 2 ? atof(argv[2]) : 3;
+    const int per_core = argc > 3 ? atoi(argv[3]) : 2;
+    const int depth = argc > 4 ? atoi(argv[4]) : 64;
+    const int keys = argc > 5 ? atoi(argv[5]) : 1000000;
+
+    double base = 0;
+    int cores = 1;
+    for (;;) {
+        const double rate = bench_cores(cores, seconds, per_core, depth, keys);
+        if (cores == 1) {
+            base = rate;
+        }
+        printf("%3d cores  %2d connections x %d deep  %12.0f ops/s  %5.2fx\n", cores, cores * per_core, depth, rate,
+               rate / base);
+        fflush(stdout);
+        if (cores >= max_cores) {
+            break;
+        }
+        cores = cores * 2 < max_cores ? cores * 2 : max_cores;
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cache.h"
+#include "hash_table_internal.h"
+
+static void ht_cache_unlink(ht_cache_entry* e) {
+    e->prev->next = e->next;
+    e->next->prev = e->prev;
+}
+
+static void ht_cache_push_front(ht_cache* cache, ht_cache_entry* e) {
+    e->prev = &cache->list;
+    e->next = cache->list.next;
+    cache->list.next->prev = e;
+    cache->list.next = e;
+}
+
+//what an entry costs against max_bytes: the entry itself plus both strings
+static size_t ht_cache_charge(const char* key, const char* value) {
+    return sizeof(ht_cache_entry) + strlen(key) + 1 + strlen(value) + 1;
+}
+
+static int ht_cache_over_capacity(const ht_cache* cache) {
+    return (cache->max_entries != 0 && (size_t)cache->table->count > cache->max_entries) ||
+           (cache->max_bytes != 0 && cache->bytes > cache->max_bytes);
+}
+
+//whether adding an entry of this charge would push the cache over either capacity
+static int ht_cache_full_for(const ht_cache* cache, const size_t charge) {
+    return (cache->max_entries != 0 && (size_t)cache->table->count + 1 > cache->max_entries) ||
+           (cache->max_bytes != 0 && cache->bytes + charge > cache->max_bytes);
+}
+
+//unlinks the entry, tells the owner and lets the table free it
+static void ht_cache_drop(ht_cache* cache, ht_cache_entry* e, const int evicted) {
+    ht_cache_unlink(e);
+    cache->bytes -= e->charge;
+    if (evicted) {
+        cache->evictions++;
+        if (cache->on_evict != NULL) {
+            cache->on_evict(e->item.key, e->item.value, cache->evict_ctx);
+        }
+    }
+    ht_delete(cache->table, e->item.key);
+}
+
+//The entry ht_cache_victim would pick, leaving the list and the reference bits alone: under CLOCK the hand passes
+//referenced entries, and when every entry is referenced it comes round to the back one again.
+static const ht_cache_entry* ht_cache_next_victim(const ht_cache* cache) {
+    const ht_cache_entry* e = cache->list.prev;
+    if (cache->policy == HT_CACHE_CLOCK) {
+        while (e != &cache->list && e->referenced) {
+            e = e->prev;
+        }
+        if (e == &cache->list) {
+            e = cache->list.prev;
+        }
+    }
+    return e;
+}
+
+//picks the entry at the back of the list, under CLOCK referenced entries get their bit cleared and go round again
+//only for an actual eviction, admission compares against ht_cache_next_victim so a rejection leaves the hand in place
+static ht_cache_entry* ht_cache_victim(ht_cache* cache) {
+    ht_cache_entry* e = cache->list.prev;
+    if (cache->policy == HT_CACHE_CLOCK) {
+        while (e->referenced) {
+            e->referenced = 0;
+            ht_cache_unlink(e);
+            ht_cache_push_front(cache, e);
+            e = cache->list.prev;
+        }
+    }
+    return e;
+}
+
+ht_cache* ht_cache_new(const int policy, const size_t max_entries, const size_t max_bytes, ht_evict_fn on_evict, void* evict_ctx) {
+    ht_cache* cache = ht_calloc(1, sizeof(ht_cache));
+    cache->table = ht_new();
+    cache->table->embedded_size = sizeof(ht_cache_entry);
+    cache->policy = policy;
+    cache->max_entries = max_entries;
+    cache->max_bytes = max_bytes;
+    cache->list.prev = &cache->list;
+    cache->list.next = &cache->list;
+    cache->on_evict = on_evict;
+    cache->evict_ctx = evict_ctx;
+    return cache;
+}
+
+//turns on TinyLFU admission with a sketch sized for about expected_entries hot keys, normally the entry capacity
+void ht_cache_enable_admission(ht_cache* cache, const size_t expected_entries) {
+    if (cache->admission == NULL) {
+        cache->admission = ht_malloc(sizeof(ht_freq_sketch));
+        ht_freq_init(cache->admission, expected_entries);
+    }
+}
+
+//The hash a key is counted and looked up under. The admission sketch needs one that stays the same for the cache's
+//lifetime, a reseed of the table would otherwise scatter every count; ht_fast_hash is that, and is also the table's
+//own hash until a flood of colliding keys moves it to SipHash, so a get or put normally hashes the key only once.
+static uint64_t ht_cache_hash(const char* key) {
+    return ht_fast_hash(key);
+}
+
+//the entry for key, given ht_cache_hash(key)
+static ht_cache_entry* ht_cache_find(const ht_cache* cache, const char* key, const uint64_t hash) {
+    ht_hash_table* table = cache->table;
+    return (ht_cache_entry*)ht_search_hashed(table, key, table->hash_mode == HT_HASH_FAST ? hash : ht_hash(table, key));
+}
+
+//frees every entry without calling the eviction callback
+void ht_cache_free(ht_cache* cache) {
+    if (cache->admission != NULL) {
+        ht_freq_free(cache->admission);
+        free(cache->admission);
+    }
+    ht_delete_hash_table(cache->table);
+    free(cache);
+}
+
+//returns the cached value or NULL, a hit refreshes the entry's recency
+//with admission enabled every call, hit or miss, counts towards the key's popularity
+char* ht_cache_get(ht_cache* cache, const char* key) {
+    const uint64_t hash = ht_cache_hash(key);
+    if (cache->admission != NULL) {
+        ht_freq_increment(cache->admission, hash);
+    }
+    ht_cache_entry* e = ht_cache_find(cache, key, hash);
+    if (e == NULL) {
+        cache->misses++;
+        return NULL;
+    }
+    cache->hits++;
+    if (cache->policy == HT_CACHE_CLOCK) {
+        e->referenced = 1;
+    } else if (cache->list.next != e) {
+        ht_cache_unlink(e);
+        ht_cache_push_front(cache, e);
+    }
+    return e->item.value;
+}
+
+//adds or replaces key, then evicts until the cache is back within its capacity
+//with admission enabled a new key may instead be turned away when the cache is full, see ht_cache_enable_admission
+//a value whose charge alone exceeds max_bytes is turned away without evicting anything, and an older value of the key
+//is dropped rather than served stale
+void ht_cache_put(ht_cache* cache, const char* key, const char* value) {
+    const uint64_t hash = ht_cache_hash(key);
+    ht_cache_entry* e = ht_cache_find(cache, key, hash);
+    const size_t charge = ht_cache_charge(key, value);
+    if (cache->max_bytes != 0 && charge > cache->max_bytes) {
+        if (e != NULL) {
+            ht_cache_drop(cache, e, 0);
+        }
+        cache->rejections++;
+        return;
+    }
+    if (e != NULL) {
+        const size_t old_len = strlen(e->item.value);
+        if (!(e->item.flags & HT_ITEM_BORROWED_VALUE)) {
+            free(e->item.value); //not one ht_shrink_to_fit packed
+        }
+        e->item.value = ht_strdup(value);
+        e->item.flags &= ~(HT_ITEM_BORROWED_VALUE | HT_ITEM_PACKED_VALUE);
+        cache->table->value_bytes += strlen(value) - old_len;
+        cache->bytes -= e->charge;
+        e->charge = charge;
+        cache->bytes += e->charge;
+        ht_cache_unlink(e);
+        ht_cache_push_front(cache, e);
+    } else {
+        if (cache->admission != NULL && cache->list.next != &cache->list && ht_cache_full_for(cache, charge)) {
+            //the candidate must have been asked for more often than the entry it would push out
+            const ht_cache_entry* victim = ht_cache_next_victim(cache);
+            if (ht_freq_estimate(cache->admission, hash) <=
+                ht_freq_estimate(cache->admission, ht_cache_hash(victim->item.key))) {
+                cache->rejections++;
+                return;
+            }
+        }
+        e = ht_malloc(sizeof(ht_cache_entry));
+        e->item.key = ht_strdup(key);
+        e->item.value = ht_strdup(value);
+        e->item.flags = 0; //ht_insert_item adds HT_ITEM_EMBEDDED
+        e->charge = charge;
+        e->referenced = 0;
+        ht_insert_item(cache->table, &e->item);
+        ht_cache_push_front(cache, e);
+        cache->bytes += e->charge;
+    }
+    while (cache->list.next != &cache->list && ht_cache_over_capacity(cache)) {
+        ht_cache_drop(cache, ht_cache_victim(cache), 1);
+    }
+}
+
+//removes key if present, without calling the eviction callback
+void ht_cache_remove(ht_cache* cache, const char* key) {
+    ht_cache_entry* e = (ht_cache_entry*)ht_search_item(cache->table, key);
+    if (e != NULL) {
+        ht_cache_drop(cache, e, 0);
+    }
+}
@@ -0,0 +1,70 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#ifndef CACHE_H
+#define CACHE_H
+
+//A bounded cache on top of ht_hash_table. Entries carry their own recency links, so a hit is one table lookup plus
+//a pointer swap (LRU) or a bit set (CLOCK), with no allocation. When an entry or byte capacity is exceeded the
+//least recently used entry, or under CLOCK the oldest entry not referenced since the hand last passed, is evicted.
+//
+//With admission enabled a TinyLFU sketch counts how often each key is looked up, and once the cache is full a new
+//key only gets in if it has been asked for more often than the entry it would evict. One pass of a batch scan
+//then cannot flush the working set.
+
+#include <stddef.h>
+
+#include "hash_table.h"
+#include "sketch.h"
+
+#define HT_CACHE_LRU 0 //a hit moves the entry to the front of the list
+#define HT_CACHE_CLOCK 1 //a hit only sets a reference bit, eviction gives referenced entries a second chance
+
+//called with the evicted key and value just before they are freed
+typedef void (*ht_evict_fn)(const char* key, const char* value, void* ctx);
+
+typedef struct ht_cache_entry {
+    ht_item item; //first member, so the table frees an entry like any other ht_item
+    struct ht_cache_entry* prev;
+    struct ht_cache_entry* next;
+    size_t charge; //bytes counted against max_bytes
+    int referenced; //CLOCK reference bit
+} ht_cache_entry;
+
+typedef struct {
+    ht_hash_table* table;
+    int policy;
+    size_t max_entries; //0 for no entry limit
+    size_t max_bytes; //0 for no byte limit
+    size_t bytes;
+    ht_cache_entry list; //sentinel, list.next is the most recently inserted or used entry and list.prev the next victim
+    ht_evict_fn on_evict;
+    void* evict_ctx;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    ht_freq_sketch* admission; //TinyLFU frequency sketch, NULL admits every new key
+    unsigned long rejections; //puts turned away, less popular than the victim or larger than max_bytes
+} ht_cache;
+
+ht_cache* ht_cache_new(const int policy, const size_t max_entries, const size_t max_bytes, ht_evict_fn on_evict, void* evict_ctx);
+void ht_cache_free(ht_cache* cache);
+char* ht_cache_get(ht_cache* cache, const char* key);
+void ht_cache_put(ht_cache* cache, const char* key, const char* value);
+void ht_cache_remove(ht_cache* cache, const char* key);
+void ht_cache_enable_admission(ht_cache* cache, const size_t expected_entries);
+
+#endif
@@ -0,0 +1,334 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cuckoo.h"
+#include "hash_table_internal.h"
+#include "instrument.h"
+#include "prime.h"
+#include "slots.h"
+
+//Slots are kept in ht->items so that freeing, stats and anything else walking the slot array work unchanged:
+//bucket b owns ht->items[b * HT_CUCKOO_WAYS] to ht->items[b * HT_CUCKOO_WAYS + HT_CUCKOO_WAYS - 1] and the
+//HT_CUCKOO_STASH slots after the last bucket form the stash. The engine only keeps a one byte fingerprint per slot,
+//so a bucket is rejected by comparing four bytes instead of dereferencing four items.
+typedef struct {
+    int num_buckets;
+    int stash_count;
+    uint8_t* tags; //fingerprint of the key in each bucket slot, 0 marks an empty slot
+    uint32_t rng; //xorshift state used to pick kick-out victims
+} ht_cuckoo;
+
+//where a key may live, derived from a single call to ht_hash
+typedef struct {
+    int b1;
+    int b2;
+    uint8_t tag;
+} ht_cuckoo_pos;
+
+//the two halves of the hash pick the two buckets, the same split ht_probe_start uses for its double hashing
+static ht_cuckoo_pos ht_cuckoo_locate(const ht_hash_table* ht, const ht_cuckoo* c, const char* key) {
+    const uint64_t hash = ht_hash(ht, key);
+    ht_cuckoo_pos pos;
+    pos.b1 = (int)((hash & 0xffffffff) % (uint64_t)c->num_buckets);
+    pos.b2 = (int)((hash >> 32) % (uint64_t)c->num_buckets);
+    if (pos.b2 == pos.b1) {
+        pos.b2 = (pos.b1 + 1) % c->num_buckets;
+    }
+    pos.tag = (uint8_t)(((hash * 0x9E3779B97F4A7C15ULL) >> 56) | 1);
+    return pos;
+}
+
+static uint32_t ht_cuckoo_rand(ht_cuckoo* c) {
+    c->rng ^= c->rng << 13;
+    c->rng ^= c->rng >> 17;
+    c->rng ^= c->rng << 5;
+    return c->rng;
+}
+
+static void ht_cuckoo_alloc(ht_hash_table* ht, ht_cuckoo* c, const int num_buckets) {
+    c->num_buckets = num_buckets;
+    c->stash_count = 0;
+    c->tags = ht_calloc((size_t)num_buckets * HT_CUCKOO_WAYS, sizeof(uint8_t));
+    ht->base_size = num_buckets * HT_CUCKOO_WAYS;
+    ht->size = num_buckets * HT_CUCKOO_WAYS + HT_CUCKOO_STASH;
+    ht->items = ht_slots_alloc((size_t)ht->size);
+    if (ht->numa != HT_NUMA_ANY) {
+        ht_slots_place(ht->items, ht->numa, 0);
+    }
+}
+
+//puts item, which was in slot from (-1 if it is new), in a free slot of bucket, returns 0 if the bucket is full
+static int ht_cuckoo_place(ht_hash_table* ht, ht_cuckoo* c, const int bucket, ht_item* item, const uint8_t tag, const int from) {
+    for (int w = 0; w < HT_CUCKOO_WAYS; w++) {
+        const int slot = bucket * HT_CUCKOO_WAYS + w;
+        if (c->tags[slot] == 0) {
+            ht->items[slot] = item;
+            c->tags[slot] = tag;
+            ht_moved(ht, from, slot);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//Picks the slot of bucket whose resident gets kicked out. While an ht_scan walk is under way, residents whose other
+//bucket lies behind the scan cursor are avoided where possible since moving one there restarts the walk.
+static int ht_cuckoo_victim(ht_hash_table* ht, ht_cuckoo* c, const int bucket) {
+    const int first = (int)(ht_cuckoo_rand(c) % HT_CUCKOO_WAYS);
+    if (ht->scan_mark == 0) {
+        return bucket * HT_CUCKOO_WAYS + first;
+    }
+    for (int w = 0; w < HT_CUCKOO_WAYS; w++) {
+        const int slot = bucket * HT_CUCKOO_WAYS + (first + w) % HT_CUCKOO_WAYS;
+        const ht_cuckoo_pos pos = ht_cuckoo_locate(ht, c, ht->items[slot]->key);
+        const int other = bucket == pos.b1 ? pos.b2 : pos.b1;
+        if (other > bucket || other * HT_CUCKOO_WAYS >= ht->scan_mark) {
+            return slot;
+        }
+    }
+    return bucket * HT_CUCKOO_WAYS + first;
+}
+
+//Adds an item known not to be in the table. When both buckets are full a random resident is kicked out to its
+//other bucket, and so on for up to HT_CUCKOO_MAX_KICKS moves, then the stash takes whatever is left over.
+//Returns NULL on success, or the item that ended up without a slot (not necessarily the one passed in).
+static ht_item* ht_cuckoo_add(ht_hash_table* ht, ht_cuckoo* c, ht_item* item, ht_cuckoo_pos pos) {
+    if (ht_cuckoo_place(ht, c, pos.b1, item, pos.tag, -1) || ht_cuckoo_place(ht, c, pos.b2, item, pos.tag, -1)) {
+        return NULL;
+    }
+    int bucket = (ht_cuckoo_rand(c) & 1) ? pos.b1 : pos.b2;
+    int from = -1;
+    for (int kick = 0; kick < HT_CUCKOO_MAX_KICKS; kick++) {
+        const int slot = ht_cuckoo_victim(ht, c, bucket);
+        ht_item* victim = ht->items[slot];
+        ht->items[slot] = item;
+        c->tags[slot] = pos.tag;
+        ht_moved(ht, from, slot);
+        item = victim;
+        from = slot;
+        pos = ht_cuckoo_locate(ht, c, item->key);
+        bucket = bucket == pos.b1 ? pos.b2 : pos.b1;
+        if (ht_cuckoo_place(ht, c, bucket, item, pos.tag, from)) {
+            return NULL;
+        }
+    }
+    if (c->stash_count < HT_CUCKOO_STASH) {
+        ht->items[c->num_buckets * HT_CUCKOO_WAYS + c->stash_count] = item;
+        c->stash_count++;
+        return NULL;
+    }
+    return item;
+}
+
+//Re-adds every item plus extra into fresh buckets, doubling num_buckets until they all fit.
+//Used both to grow and to move onto a new seed.
+static void ht_cuckoo_rebuild(ht_hash_table* ht, int num_buckets, ht_item* extra) {
+    ht_cuckoo* c = ht->engine;
+    ht_item** all = ht_malloc(sizeof(ht_item*) * ((size_t)ht->count + 1));
+    int n = 0;
+    for (int i = 0; i < ht->size; i++) {
+        if (ht->items[i] != NULL) {
+            all[n++] = ht->items[i];
+        }
+    }
+    if (extra != NULL) {
+        all[n++] = extra;
+    }
+    ht_slots_free(ht->items);
+    free(c->tags);
+    ht_moved_all(ht);
+    HT_COUNT(resizes, 1);
+    HT_COUNT(resize_items_moved, n);
+    for (;;) {
+        ht_cuckoo_alloc(ht, c, num_buckets);
+        int i = 0;
+        while (i < n && ht_cuckoo_add(ht, c, all[i], ht_cuckoo_locate(ht, c, all[i]->key)) == NULL) {
+            i++;
+        }
+        if (i == n) {
+            break;
+        }
+        //every item is still referenced from all, so just throw the half filled arrays away
+        ht_slots_free(ht->items);
+        free(c->tags);
+        num_buckets = next_prime(num_buckets * 2);
+    }
+    free(all);
+}
+
+//Returns the slot holding key, or -1. Reads the fingerprints of b1 and b2, and the stash only when it is in use.
+static int ht_cuckoo_find(const ht_hash_table* ht, const ht_cuckoo* c, const char* key, const ht_cuckoo_pos pos, int* buckets_read) {
+    __builtin_prefetch(&ht->items[pos.b2 * HT_CUCKOO_WAYS]);
+    __builtin_prefetch(&c->tags[pos.b2 * HT_CUCKOO_WAYS]);
+    const int buckets[2] = {pos.b1, pos.b2};
+    for (int b = 0; b < 2; b++) {
+        for (int w = 0; w < HT_CUCKOO_WAYS; w++) {
+            const int slot = buckets[b] * HT_CUCKOO_WAYS + w;
+            if (c->tags[slot] == pos.tag && strcmp(ht->items[slot]->key, key) == 0) {
+                *buckets_read = b + 1;
+                return slot;
+            }
+        }
+    }
+    *buckets_read = 2;
+    if (c->stash_count > 0) {
+        *buckets_read = 3;
+        for (int s = 0; s < c->stash_count; s++) {
+            const int slot = c->num_buckets * HT_CUCKOO_WAYS + s;
+            if (strcmp(ht->items[slot]->key, key) == 0) {
+                return slot;
+            }
+        }
+    }
+    return -1;
+}
+
+//moves stashed items back into their buckets once a delete has made room
+static void ht_cuckoo_drain_stash(ht_hash_table* ht, ht_cuckoo* c) {
+    const int stash = c->num_buckets * HT_CUCKOO_WAYS;
+    int s = 0;
+    while (s < c->stash_count) {
+        ht_item* item = ht->items[stash + s];
+        const ht_cuckoo_pos pos = ht_cuckoo_locate(ht, c, item->key);
+        if (ht_cuckoo_place(ht, c, pos.b1, item, pos.tag, stash + s) || ht_cuckoo_place(ht, c, pos.b2, item, pos.tag, stash + s)) {
+            c->stash_count--;
+            ht->items[stash + s] = ht->items[stash + c->stash_count];
+            ht_moved(ht, stash + c->stash_count, stash + s);
+            ht->items[stash + c->stash_count] = NULL;
+        } else {
+            s++;
+        }
+    }
+}
+
+//replaces the open addressing slot array ht_new_sized made with cuckoo buckets of about the same capacity
+void ht_cuckoo_init(ht_hash_table* ht) {
+    ht_cuckoo* c = ht_calloc(1, sizeof(ht_cuckoo));
+    c->rng = 0x9E3779B9u;
+    ht->engine = c;
+    ht_slots_free(ht->items);
+    ht_cuckoo_alloc(ht, c, next_prime(ht->base_size / HT_CUCKOO_WAYS + 1));
+}
+
+//items are freed by ht_delete_hash_table along with the slot array, only the engine state is left
+void ht_cuckoo_free(ht_hash_table* ht) {
+    ht_cuckoo* c = ht->engine;
+    free(c->tags);
+    free(c);
+    ht->engine = NULL;
+}
+
+void ht_cuckoo_insert(ht_hash_table* ht, const char* key, const char* value, const int borrow) {
+    HT_TIMER_START(timer);
+    HT_COUNT(inserts, 1);
+    ht_cuckoo* c = ht->engine;
+    const ht_cuckoo_pos pos = ht_cuckoo_locate(ht, c, key);
+    int buckets_read;
+    const int slot = ht_cuckoo_find(ht, c, key, pos, &buckets_read);
+    HT_COUNT(insert_probes, buckets_read);
+    ht_item* item = ht_new_item(key, value, borrow);
+    if (slot >= 0) {
+        ht->value_bytes -= strlen(ht->items[slot]->value) + 1;
+        ht->value_bytes += strlen(item->value) + 1;
+        ht->item_bytes -= ht_item_size(ht, ht->items[slot]);
+        ht->item_bytes += ht_item_size(ht, item);
+        ht_delete_item(ht->items[slot]);
+        ht->items[slot] = item;
+        HT_TIMER_STOP(timer, insert_cycles);
+        return;
+    }
+    ht_item* homeless = ht_cuckoo_add(ht, c, item, pos);
+    ht->count++;
+    ht->key_bytes += strlen(item->key) + 1;
+    ht->value_bytes += strlen(item->value) + 1;
+    ht->item_bytes += ht_item_size(ht, item);
+    if (homeless != NULL) {
+        if (ht->hash_mode == HT_HASH_FAST && ht->count < ht->size / 2) {
+            //buckets and stash full at under half load: the keys collide on purpose, move onto a keyed hash
+            ht->hash_mode = HT_HASH_SIPHASH;
+            ht_random_seed(ht->seed);
+            ht->reseeds++;
+            ht_cuckoo_rebuild(ht, c->num_buckets, homeless);
+        } else {
+            ht_cuckoo_rebuild(ht, next_prime(c->num_buckets * 2), homeless);
+        }
+    }
+    HT_TIMER_STOP(timer, insert_cycles);
+}
+
+//the item holding key or NULL, for callers that need the item itself rather than its value
+ht_item* ht_cuckoo_lookup(ht_hash_table* ht, const char* key) {
+    ht_cuckoo* c = ht->engine;
+    int buckets_read;
+    const int slot = ht_cuckoo_find(ht, c, key, ht_cuckoo_locate(ht, c, key), &buckets_read);
+    return slot < 0 ? NULL : ht->items[slot];
+}
+
+char* ht_cuckoo_search(ht_hash_table* ht, const char* key) {
+    HT_TIMER_START(timer);
+    HT_COUNT(searches, 1);
+    ht_cuckoo* c = ht->engine;
+    int buckets_read;
+    const int slot = ht_cuckoo_find(ht, c, key, ht_cuckoo_locate(ht, c, key), &buckets_read);
+    HT_COUNT(search_probes, buckets_read);
+    //1, 2 and 3 buckets read land in the first three histogram buckets
+    if (slot < 0) {
+        ht->miss_probes[buckets_read - 1]++;
+        HT_TIMER_STOP(timer, search_cycles);
+        return NULL;
+    }
+    ht->hit_probes[buckets_read - 1]++;
+    HT_TIMER_STOP(timer, search_cycles);
+    return ht->items[slot]->value;
+}
+
+int ht_cuckoo_delete(ht_hash_table* ht, const char* key) {
+    HT_TIMER_START(timer);
+    HT_COUNT(deletes, 1);
+    ht_cuckoo* c = ht->engine;
+    int buckets_read;
+    const int slot = ht_cuckoo_find(ht, c, key, ht_cuckoo_locate(ht, c, key), &buckets_read);
+    HT_COUNT(delete_probes, buckets_read);
+    if (slot < 0) {
+        HT_TIMER_STOP(timer, delete_cycles);
+        return 0;
+    }
+    ht_item* item = ht->items[slot];
+    ht->key_bytes -= strlen(item->key) + 1;
+    ht->value_bytes -= strlen(item->value) + 1;
+    ht->item_bytes -= ht_item_size(ht, item);
+    ht_delete_item(item);
+    ht->count--;
+    const int stash = c->num_buckets * HT_CUCKOO_WAYS;
+    if (slot >= stash) {
+        //keep the stash packed at its start so lookups can stop at stash_count
+        c->stash_count--;
+        ht->items[slot] = ht->items[stash + c->stash_count];
+        ht_moved(ht, stash + c->stash_count, slot);
+        ht->items[stash + c->stash_count] = NULL;
+    } else {
+        ht->items[slot] = NULL;
+        c->tags[slot] = 0;
+        if (c->stash_count > 0) {
+            ht_cuckoo_drain_stash(ht, c);
+        }
+    }
+    HT_TIMER_STOP(timer, delete_cycles);
+    return 1;
+}
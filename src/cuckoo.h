@@ -0,0 +1,36 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#ifndef CUCKOO_H
+#define CUCKOO_H
+
+//Bucketized cuckoo layout (HT_LAYOUT_CUCKOO): every key lives in one of two 4-way buckets or in a small stash,
+//so ht_search looks at no more than two buckets plus the stash whatever the load.
+
+#include "hash_table.h"
+
+#define HT_CUCKOO_WAYS 4 //slots per bucket
+#define HT_CUCKOO_STASH 8 //overflow slots for keys whose kick-out path failed
+#define HT_CUCKOO_MAX_KICKS 500 //displacements tried before an insert falls back to the stash
+
+void ht_cuckoo_init(ht_hash_table* ht);
+void ht_cuckoo_free(ht_hash_table* ht);
+void ht_cuckoo_insert(ht_hash_table* ht, const char* key, const char* value, const int borrow);
+char* ht_cuckoo_search(ht_hash_table* ht, const char* key);
+ht_item* ht_cuckoo_lookup(ht_hash_table* ht, const char* key);
+int ht_cuckoo_delete(ht_hash_table* ht, const char* key);
+
+#endif
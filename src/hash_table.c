@@ -14,33 +14,131 @@
 //Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
 //Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/random.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 #include "hash_table.h"
+#include "hash_table_internal.h"
+#include "cuckoo.h"
+#include "hopscotch.h"
+#include "instrument.h"
+#include "prime.h"
+#include "siphash.h"
+#include "slots.h"
+#include "sketch.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
 
 #define HT_PRIME_1 2423
 #define HT_PRIME_2 2287
 #define HT_INITIAL_BASE_SIZE 53
+#define HT_ITER_PREFETCH 8 //slots ahead of the iterator whose items are prefetched
+#define HT_SCAN_EPOCH_SHIFT 40 //ht_scan cursors keep the slot index below this bit and the resize epoch above it
+#define HT_PARALLEL_CHUNK 4096 //slots per ht_parallel_for_each chunk, 32KB of slot pointers and whole cache lines
+#define HT_PARALLEL_RESIZE_MIN 65536 //below this many items starting the pool's threads costs more than it saves
+#define HT_FLOOD_PROBES 64 //a probe sequence longer than this means keys collide far more than a random hash allows
+#define HT_SEARCH_BATCH 16 //keys of an ht_search_batch whose buckets are prefetched together
+#define HT_FILTER_STALE_DIV 8 //the filter is rebuilt once size / 8 keys have been removed from it
 
-static ht_item HT_DELETED_ITEM = {NULL, NULL};
+static ht_item HT_DELETED_ITEM = {NULL, NULL, 0};
+
+static void ht_reseed(ht_hash_table* ht);
+static ht_bloom* ht_filter_new(const int size);
+static void ht_filter_free(ht_bloom* filter);
+static void ht_free_packed(struct ht_pack_block* block);
+static void ht_filter_rebuild(ht_hash_table* ht);
+static void ht_resize(ht_hash_table* ht, const int base_size);
+static void ht_resize_up(ht_hash_table* ht);
+static void ht_resize_down(ht_hash_table* ht);
+
+//malloc that aborts instead of returning NULL, the table has no way to report a failed allocation to its caller
+void* ht_malloc(const size_t size) {
+    void* p = malloc(size);
+    if (p == NULL) {
+        abort();
+    }
+    return p;
+}
+
+//calloc that aborts instead of returning NULL
+void* ht_calloc(const size_t count, const size_t size) {
+    void* p = calloc(count, size);
+    if (p == NULL) {
+        abort();
+    }
+    return p;
+}
+
+//strdup that aborts instead of returning NULL
+char* ht_strdup(const char* s) {
+    char* copy = strdup(s);
+    if (copy == NULL) {
+        abort();
+    }
+    return copy;
+}
+
+//aligned_alloc that aborts instead of returning NULL
+void* ht_aligned_alloc(const size_t alignment, const size_t size) {
+    void* p = aligned_alloc(alignment, size);
+    if (p == NULL) {
+        abort();
+    }
+    return p;
+}
 
 //initialization of a new ht_item, allocates memory space, and assigns key and value variables, returns a pointer to the new item
-static ht_item* ht_new_item(const char* k, const char* v){
-    ht_item *i = malloc(sizeof(ht_item)); //static allocation
-    i->key = strdup(k); //strdup() returns a duplicate of the given string, necassary when working with pointers
-    i->value = strdup(v);
+//borrow holds HT_ITEM_BORROWED_KEY and/or HT_ITEM_BORROWED_VALUE for strings stored by reference instead of copied
+ht_item* ht_new_item(const char* k, const char* v, const int borrow){
+    ht_item *i = ht_malloc(sizeof(ht_item)); //static allocation
+    //strdup() returns a duplicate of the given string, necassary when working with pointers
+    i->key = (borrow & HT_ITEM_BORROWED_KEY) ? (char*)k : ht_strdup(k);
+    i->value = (borrow & HT_ITEM_BORROWED_VALUE) ? (char*)v : ht_strdup(v);
+    i->flags = borrow & (HT_ITEM_BORROWED_KEY | HT_ITEM_BORROWED_VALUE);
     return i;
 }
 
 static ht_hash_table* ht_new_sized(const int base_size) {
-    ht_hash_table* ht = xmalloc(sizeof(ht_hash_table));
+    ht_hash_table* ht = ht_malloc(sizeof(ht_hash_table));
     ht->base_size = base_size;
+    ht->reserved_base = 0;
 
     ht->size = next_prime(ht->base_size);
 
     ht->count = 0;
-    ht->items = xcalloc((size_t)ht->size, sizeof(ht_item*));
+    ht->layout = HT_LAYOUT_OPEN;
+    ht->engine = NULL;
+    ht->hash_mode = HT_HASH_FAST;
+    ht->seed[0] = 0;
+    ht->seed[1] = 0;
+    ht->tombstones = 0;
+    ht->reseeds = 0;
+    ht->inserts_since_reseed = 0;
+    ht->flood_suspected = 0;
+    ht->wheel = NULL;
+    ht->resize_epoch = 0;
+    ht->scan_mark = 0;
+    ht->resize_pool = NULL;
+    ht->key_sketch = NULL;
+    ht->filter = NULL;
+    ht->filter_stale = 0;
+    ht->filter_rejects = 0;
+    ht->numa = HT_NUMA_ANY;
+    ht->packed = NULL;
+    ht->borrow = 0;
+    ht->key_bytes = 0;
+    ht->value_bytes = 0;
+    ht->item_bytes = 0;
+    ht->embedded_size = sizeof(ht_item);
+    memset(ht->hit_probes, 0, sizeof(ht->hit_probes));
+    memset(ht->miss_probes, 0, sizeof(ht->miss_probes));
+    ht->items = ht_slots_alloc((size_t)ht->size);
     /*
     The stdlib.h and stddef.h header files define a datatype called size_t which is used to represent the size of an object. 
     Library functions that take sizes expect them to be of type size_t, and the sizeof operator evaluates to size_t.
@@ -56,11 +154,82 @@ ht_hash_table* ht_new() {
     return ht_new_sized(HT_INITIAL_BASE_SIZE);
 }
 
+//fills seed with 128 random bits, from getrandom() when the kernel has it and /dev/urandom otherwise
+void ht_random_seed(uint64_t seed[2]) {
+    if (getrandom(seed, sizeof(uint64_t) * 2, 0) == (ssize_t)(sizeof(uint64_t) * 2)) {
+        return;
+    }
+    FILE* f = fopen("/dev/urandom", "rb");
+    if (f != NULL) {
+        const size_t got = fread(seed, sizeof(uint64_t), 2, f);
+        fclose(f);
+        if (got == 2) {
+            return;
+        }
+    }
+    //last resort, still differs per table and per run
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    seed[0] = ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) ^ (uint64_t)(uintptr_t)seed;
+    const uint64_t key[2] = {seed[0], (uint64_t)(uintptr_t)&ts}; //not seed itself, fread may have left seed[1] half written
+    seed[1] = siphash13(&ts, sizeof(ts), key);
+}
+
+//a table whose keys are hashed with SipHash-1-3 under a random seed, for tables fed by untrusted input
+//costs more per hash than ht_new(), see bench_hash.c for the numbers on your machine
+ht_hash_table* ht_new_seeded() {
+    ht_hash_table* ht = ht_new_sized(HT_INITIAL_BASE_SIZE);
+    ht->hash_mode = HT_HASH_SIPHASH;
+    ht_random_seed(ht->seed);
+    return ht;
+}
+
+//a table using one of the HT_LAYOUT_ slot organisations, the ht_ functions dispatch on ht->layout
+ht_hash_table* ht_new_layout(const int layout) {
+    ht_hash_table* ht = ht_new_sized(HT_INITIAL_BASE_SIZE);
+    ht->layout = layout;
+    if (layout == HT_LAYOUT_CUCKOO) {
+        ht_cuckoo_init(ht);
+    } else if (layout == HT_LAYOUT_HOPSCOTCH) {
+        ht_hopscotch_init(ht);
+    }
+    return ht;
+}
+
+//copies the hashing configuration of src onto a freshly created table, used when a resize builds a new bucket array
+//the new array is placed on src's NUMA nodes before anything is stored in it
+static void ht_inherit_config(ht_hash_table* dst, const ht_hash_table* src) {
+    dst->hash_mode = src->hash_mode;
+    dst->seed[0] = src->seed[0];
+    dst->seed[1] = src->seed[1];
+    dst->numa = src->numa;
+    if (src->numa != HT_NUMA_ANY) {
+        ht_slots_place(dst->items, src->numa, 0);
+    }
+}
+
+//the memory the item takes besides its strings: the flags say when it heads a larger struct
+size_t ht_item_size(const ht_hash_table* ht, const ht_item* item){
+    if (item->flags & HT_ITEM_TTL) {
+        return sizeof(ht_ttl_item);
+    }
+    return (item->flags & HT_ITEM_EMBEDDED) ? ht->embedded_size : sizeof(ht_item);
+}
+
 //delete an item from memory and therefore from the hashtable
-static void ht_delete_item(ht_item* i){
-    free(i->key);
-    free(i->value);
-    free(i);
+void ht_delete_item(ht_item* i){
+    if (i->flags & HT_ITEM_TTL) {
+        ht_timer_unlink(i);
+    }
+    if (!(i->flags & HT_ITEM_BORROWED_KEY)) {
+        free(i->key);
+    }
+    if (!(i->flags & HT_ITEM_BORROWED_VALUE)) {
+        free(i->value);
+    }
+    if (!(i->flags & HT_ITEM_PACKED)) {
+        free(i);
+    }
 }
 
 //deletes an entire hash table by individually deleting each item
@@ -68,118 +237,775 @@ void ht_delete_hash_table(ht_hash_table* ht){
     //individually delete all items in the hash table
     for(int i = 0; i < ht->size; i++){
         ht_item* item = ht->items[i]; //create a new pointer instance of the current item
-        if(item != NULL)
+        if(item != NULL && item != &HT_DELETED_ITEM)
             ht_delete_item(item); //call the item delete function above
     }
-    free(ht->items);
+    if (ht->layout == HT_LAYOUT_CUCKOO) {
+        ht_cuckoo_free(ht);
+    } else if (ht->layout == HT_LAYOUT_HOPSCOTCH) {
+        ht_hopscotch_free(ht);
+    }
+    if (ht->wheel != NULL) {
+        ht_timer_wheel_free(ht->wheel); //after the items, freeing them unlinks them from the wheel
+    }
+    ht_filter_free(ht->filter);
+    ht_free_packed(ht->packed);
+    ht_slots_free(ht->items);
     free(ht);
 }
 
-//takes a string as input, returns a number between 0 and m (desired bucket length)
+//takes a string as input, returns the sum of a^(len_s - (i+1)) * s[i] modulo 2^32
 //The variable a should be a prime number larger than the size of the alphabet.
 //We're hashing ASCII strings, which has an alphabet size of 128, so we should choose a prime larger than that.
-static int ht_hash(const char* s, const int a, const int m){
-    long hash = 0;
-    const int len_s = strlen(s);
-    for(int i = 0; i < len_s; i++){
-        hash += (long)pow(a, len_s - (i+1)) * s[i]; //generic hashing algorithm
-        hash = hash % m;
+//Horner's rule evaluates the same polynomial as pow() would but in integer arithmetic, one multiply per character.
+static uint32_t ht_poly_hash(const char* s, const uint32_t a){
+    uint32_t hash = 0;
+    for (; *s != '\0'; s++) {
+        hash = hash * a + (unsigned char)*s; //generic hashing algorithm
+    }
+    return hash;
+}
+
+//the HT_HASH_FAST hash, the polynomial hashes for HT_PRIME_1 and HT_PRIME_2 packed together; the same for every table
+uint64_t ht_fast_hash(const char* s){
+    return ((uint64_t)ht_poly_hash(s, HT_PRIME_2) << 32) | ht_poly_hash(s, HT_PRIME_1);
+}
+
+//returns a 64 bit hash of the key, the low and high halves feed the two hashes of the double hashing in ht_probe_start
+//fast mode is ht_fast_hash, seeded mode is SipHash-1-3 under the table's seed
+uint64_t ht_hash(const ht_hash_table* ht, const char* s){
+    if (ht->hash_mode == HT_HASH_SIPHASH) {
+        return siphash13(s, strlen(s), ht->seed);
+    }
+    return ht_fast_hash(s);
+}
+
+//maps a probe length (1 = found on the first bucket) onto its ht_statistics histogram bucket
+static int ht_probe_bucket(const int probes){
+    if (probes <= 1) {
+        return 0;
     }
-    return (int) hash;
+    const int bucket = 32 - __builtin_clz((unsigned int)(probes - 1));
+    return bucket < HT_PROBE_HIST_BUCKETS ? bucket : HT_PROBE_HIST_BUCKETS - 1;
 }
 
+//where a key's double hashing probe sequence has got to
+typedef struct {
+    int index;
+    int step;
+    int num_buckets;
+} ht_probe;
+
 //handles collisions by running the hash value through multiple different hashing functions
-static int ht_get_hash(const char* s, const int num_buckets, const int attempt){
-    const int hash_a = ht_hash(s, HT_PRIME_1, num_buckets);
-    const int hash_b = ht_hash(s, HT_PRIME_2, num_buckets);
-    return (hash_a + (attempt * (hash_b + 1))) % num_buckets;
+//the step hash_b + 1 is kept in [1, num_buckets - 1] so that, num_buckets being prime, every bucket is eventually visited
+//the key is hashed once, by the caller or by ht_probe_start, and every later attempt is just an add, ht_probe_next
+static ht_probe ht_probe_at(const uint64_t hash, const int num_buckets){
+    ht_probe probe;
+    probe.index = (int)((hash & 0xffffffff) % (uint64_t)num_buckets); //hash_a
+    probe.step = (int)((hash >> 32) % (uint64_t)(num_buckets - 1)) + 1; //hash_b + 1
+    probe.num_buckets = num_buckets;
+    return probe;
+}
+
+static ht_probe ht_probe_start(const ht_hash_table* ht, const char* s, const int num_buckets){
+    return ht_probe_at(ht_hash(ht, s), num_buckets);
+}
+
+//counts key in the attached key sketch, for the insert paths whose probing does not hand over the key's hash
+static void ht_sketch_key(ht_hash_table* ht, const char* key){
+    if (ht->key_sketch != NULL) {
+        ht_key_sketch_add(ht->key_sketch, key, ht_hash(ht, key));
+    }
+}
+
+//moves on to the next bucket of the sequence, (hash_a + attempt * (hash_b + 1)) % num_buckets without overflowing
+static int ht_probe_next(ht_probe* probe){
+    const int room = probe->num_buckets - probe->step;
+    probe->index = probe->index >= room ? probe->index - room : probe->index + probe->step;
+    return probe->index;
+}
+
+//frees the item in the bucket at index and leaves a tombstone so the probe chains through it stay intact
+static void ht_remove_at(ht_hash_table* ht, const int index){
+    ht_item* item = ht->items[index];
+    ht->key_bytes -= strlen(item->key) + 1;
+    ht->value_bytes -= strlen(item->value) + 1;
+    ht->item_bytes -= ht_item_size(ht, item);
+    ht_delete_item(item);
+    ht->items[index] = &HT_DELETED_ITEM;
+    ht->tombstones++;
+    ht->count--; //only count keys that were actually present
+    //a Bloom filter cannot forget a key, so once enough removed keys linger in it start it over from the live ones
+    if (ht->filter != NULL && ++ht->filter_stale > ht->size / HT_FILTER_STALE_DIV) {
+        ht_filter_rebuild(ht);
+    }
+}
+
+//stores a new item in the free or deleted bucket at index that took probes attempts to reach, and does the bookkeeping
+static void ht_occupy(ht_hash_table* ht, const int index, ht_item* item, const int probes){
+    //reusing a deleted bucket takes it out of the tombstone count
+    if (ht->items[index] == &HT_DELETED_ITEM) {
+        ht->tombstones--;
+    }
+    //add new item to the hash table once an index has been found
+    //released so that ht_search_shared, reading concurrently, sees the item filled in
+    __atomic_store_n(&ht->items[index], item, __ATOMIC_RELEASE);
+    ht->count++; //increment counter for amount of entries in the hash table
+    ht->key_bytes += strlen(item->key) + 1;
+    ht->value_bytes += strlen(item->value) + 1;
+    ht->item_bytes += ht_item_size(ht, item);
+    ht->inserts_since_reseed++;
+    if (probes > HT_FLOOD_PROBES || ht->flood_suspected) {
+        ht_reseed(ht);
+    }
+}
+
+//Grows the table past 70% load before an insert. When it is tombstones rather than keys that fill it up the table
+//is rebuilt at the same size instead, either way every probe sequence is left ending at an empty bucket.
+static void ht_make_room(ht_hash_table* ht){
+    if ((long long)ht->count * 100 / ht->size > 70) {
+        ht_resize_up(ht);
+    } else if ((long long)(ht->count + ht->tombstones) * 100 / ht->size > 70) {
+        ht_resize(ht, ht->base_size);
+    }
+}
+
+//Probes for key once: returns the bucket holding its item and sets *found, or else returns the bucket an item for key
+//should be added in, the first deleted bucket passed or the empty one that ended the probe. An expired TTL item for
+//key is removed on the way. *probes gets the number of buckets visited.
+static int ht_find_slot(ht_hash_table* ht, const char* key, int* found, int* probes){
+    const uint64_t hash = ht_hash(ht, key);
+    if (ht->key_sketch != NULL) {
+        ht_key_sketch_add(ht->key_sketch, key, hash); //every insert path comes through here, count the key once
+    }
+    ht_probe probe = ht_probe_at(hash, ht->size);
+    int index = probe.index;
+    int free_index = -1;
+    ht_item* item = ht->items[index];
+    int i = 1;
+    while (item != NULL) {
+        if (item == &HT_DELETED_ITEM) {
+            if (free_index < 0) {
+                free_index = index;
+            }
+        } else if (strcmp(item->key, key) == 0) {
+            if (!(item->flags & HT_ITEM_TTL) || !ht_timer_expired(ht->wheel, item)) {
+                *found = 1;
+                *probes = i;
+                return index;
+            }
+            ht_remove_at(ht, index);
+            free_index = free_index < 0 ? index : free_index;
+            break; //a key is in the table at most once
+        }
+        index = ht_probe_next(&probe);
+        item = ht->items[index];
+        i++;
+    }
+    *found = 0;
+    *probes = i;
+    //added last, removing an expired item above may have rebuilt the filter; harmless if an upsert then backs out
+    if (ht->filter != NULL) {
+        ht_bloom_add(ht->filter, hash);
+    }
+    return free_index >= 0 ? free_index : index;
 }
 
 //To insert a new key-value pair, we iterate through indexes until we find an empty bucket. 
 //We then insert the item into that bucket and increment the hash table's count attribute, to indicate a new item has been added.
 void ht_insert(ht_hash_table* ht, const char* key, const char* value){
-    const int load = ht->count * 100 / ht->size;
-    if (load > 70) {
-        ht_resize_up(ht);
+    ht_insert_borrowed(ht, key, value, ht->borrow);
+}
+
+//Grows an HT_LAYOUT_OPEN table ahead of time so that count keys fit without a resize, sparing a bulk load the
+//rehashes it would otherwise go through on the way. Never shrinks the table, and ht_delete does not shrink it back
+//below the reserved size either; only ht_shrink_to_fit gives the reservation up.
+void ht_reserve(ht_hash_table* ht, const int count){
+    if (ht->layout != HT_LAYOUT_OPEN) {
+        return;
     }
-    ht_item* item = ht_new_item(key, value); //create a blank new item
-    int index = ht_get_hash(item->key, ht->size, 0); //create a starting index hash 
-    ht_item* cur_item = ht->items[index]; //establish the starting item from the starting index
-    int i = 1;
-    //search through indexes until an empty one is found
-    while (cur_item != NULL && cur_item != &HT_DELETED_ITEM) {
-        if (strcmp(cur_item->key, key) == 0) {
-            ht_del_item(cur_item);
-            ht->items[index] = item;
-            return;
+    long long base_size = (long long)count * 100 / 70 + 1;
+    if (base_size > HT_MAX_BASE_SIZE) {
+        base_size = HT_MAX_BASE_SIZE;
+    }
+    if (base_size > ht->reserved_base) {
+        ht->reserved_base = (int)base_size;
+    }
+    if (base_size > ht->size) {
+        ht_resize(ht, (int)base_size);
+    }
+}
+
+//a block ht_shrink_to_fit packs items and their strings into, items first so they stay aligned
+typedef struct ht_pack_block {
+    struct ht_pack_block* next;
+    char data[]; //after a pointer, so aligned for the items
+} ht_pack_block;
+
+static void ht_free_packed(ht_pack_block* block){
+    while (block != NULL) {
+        ht_pack_block* next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+//whether ht_pack may move the string, those of the table's own making (copied or packed) but not borrowed ones
+static int ht_packable(const int flags, const int borrowed, const int packed){
+    return !(flags & borrowed) || (flags & packed);
+}
+
+//items on a timer wheel or embedded in a caller's struct are linked to from elsewhere, only their strings move
+static int ht_item_movable(const ht_item* item){
+    return !(item->flags & (HT_ITEM_TTL | HT_ITEM_EMBEDDED));
+}
+
+//copies string into *out, freeing it unless it was already packed, and returns the copy
+static char* ht_pack_string(char* string, const int was_packed, char** out){
+    const size_t len = strlen(string) + 1;
+    char* copy = memcpy(*out, string, len);
+    if (!was_packed) {
+        free(string);
+    }
+    *out += len;
+    return copy;
+}
+
+//Copies every item the table owns and every key and value it owns, packed ones included, into one new block, and
+//frees where they were. Whatever died in the old blocks since the last pack is dropped with them, and the survivors
+//end up side by side rather than scattered over heap pages that mostly hold freed items and strings.
+static void ht_pack(ht_hash_table* ht){
+    size_t item_bytes = 0;
+    size_t string_bytes = 0;
+    for (int i = 0; i < ht->size; i++) {
+        const ht_item* item = ht->items[i];
+        if (item == NULL || item == &HT_DELETED_ITEM) {
+            continue;
+        }
+        if (ht_item_movable(item)) {
+            item_bytes += sizeof(ht_item);
+        }
+        if (ht_packable(item->flags, HT_ITEM_BORROWED_KEY, HT_ITEM_PACKED_KEY)) {
+            string_bytes += strlen(item->key) + 1;
+        }
+        if (ht_packable(item->flags, HT_ITEM_BORROWED_VALUE, HT_ITEM_PACKED_VALUE)) {
+            string_bytes += strlen(item->value) + 1;
+        }
+    }
+    ht_pack_block* old = ht->packed;
+    ht->packed = NULL;
+    if (item_bytes + string_bytes > 0) {
+        ht->packed = ht_malloc(sizeof(ht_pack_block) + item_bytes + string_bytes);
+        ht->packed->next = NULL;
+        ht_item* next_item = (ht_item*)ht->packed->data;
+        char* out = ht->packed->data + item_bytes;
+        for (int i = 0; i < ht->size; i++) {
+            ht_item* item = ht->items[i];
+            if (item == NULL || item == &HT_DELETED_ITEM) {
+                continue;
+            }
+            if (ht_item_movable(item)) {
+                *next_item = *item;
+                if (!(item->flags & HT_ITEM_PACKED)) {
+                    free(item);
+                }
+                item = next_item++;
+                item->flags |= HT_ITEM_PACKED;
+                ht->items[i] = item;
+            }
+            if (ht_packable(item->flags, HT_ITEM_BORROWED_KEY, HT_ITEM_PACKED_KEY)) {
+                item->key = ht_pack_string(item->key, item->flags & HT_ITEM_PACKED_KEY, &out);
+                item->flags |= HT_ITEM_BORROWED_KEY | HT_ITEM_PACKED_KEY;
+            }
+            if (ht_packable(item->flags, HT_ITEM_BORROWED_VALUE, HT_ITEM_PACKED_VALUE)) {
+                item->value = ht_pack_string(item->value, item->flags & HT_ITEM_PACKED_VALUE, &out);
+                item->flags |= HT_ITEM_BORROWED_VALUE | HT_ITEM_PACKED_VALUE;
+            }
+        }
+    }
+    ht_free_packed(old);
+}
+
+//Gives memory back after a traffic spike: frees the expired items that are due, rebuilds an HT_LAYOUT_OPEN table
+//straight at the smallest size that holds its keys under the 70% load limit, instead of the halving ht_delete does
+//one step at a time and below any size ht_reserve held it at, dropping every tombstone on the way. The items and the
+//keys and values the table owns are then packed into one block, except for items a timer wheel or cache links to,
+//which keep their place; an item deleted after that keeps its space there until the next ht_shrink_to_fit. HT_LAYOUT_CUCKOO and HT_LAYOUT_HOPSCOTCH tables
+//keep the bucket count they grew to, only their items and strings are packed. A mapped slot array (see slots.h) goes back to
+//the kernel as soon as it is unmapped, and malloc_trim then returns the free pages the freed items and strings leave
+//inside the heap, which free() alone keeps. O(count), so for quiet moments rather than every few requests.
+//Item pointers from before it are stale, and values must not be freed behind the table's back, ht_upsert replaces one.
+void ht_shrink_to_fit(ht_hash_table* ht){
+    if (ht->wheel != NULL) {
+        ht_expire(ht, ht->count);
+    }
+    if (ht->layout == HT_LAYOUT_OPEN) {
+        ht->reserved_base = 0;
+        long long base_size = (long long)ht->count * 100 / 70 + 1;
+        if (base_size < HT_INITIAL_BASE_SIZE) {
+            base_size = HT_INITIAL_BASE_SIZE;
+        }
+        if (next_prime((int)base_size) < ht->size || ht->tombstones > 0) {
+            ht_resize(ht, (int)base_size);
+        }
+    }
+    ht_pack(ht);
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
+
+//ht_insert_borrowed for the alternative layouts, leaving the key sketch to the caller
+static void ht_layout_insert(ht_hash_table* ht, const char* key, const char* value, const int borrow){
+    if (ht->layout == HT_LAYOUT_CUCKOO) {
+        ht_cuckoo_insert(ht, key, value, borrow);
+    } else {
+        ht_hopscotch_insert(ht, key, value, borrow);
+    }
+}
+
+//Sets which strings ht_insert stores by reference from now on, HT_ITEM_BORROWED_KEY and/or HT_ITEM_BORROWED_VALUE,
+//0 to go back to copying. Meant for bulk loads from buffers that outlive the table, such as an mmap'd input file.
+void ht_set_borrow(ht_hash_table* ht, const int borrow){
+    ht->borrow = borrow & (HT_ITEM_BORROWED_KEY | HT_ITEM_BORROWED_VALUE);
+}
+
+//ht_insert for a single pair whose key and/or value, as given by borrow, are stored by reference instead of copied.
+//Borrowed strings must stay unchanged until the item is deleted or replaced, the table hashes and compares keys as
+//it goes, and they are never freed by the table. Saves an allocation and a copy per borrowed string.
+void ht_insert_borrowed(ht_hash_table* ht, const char* key, const char* value, const int borrow){
+    if (ht->layout != HT_LAYOUT_OPEN) {
+        ht_sketch_key(ht, key);
+        ht_layout_insert(ht, key, value, borrow);
+        return;
+    }
+    HT_TIMER_START(timer);
+    HT_COUNT(inserts, 1);
+    ht_make_room(ht);
+    int found;
+    int probes;
+    const int index = ht_find_slot(ht, key, &found, &probes);
+    HT_COUNT(insert_probes, probes);
+    ht_item* item = ht_new_item(key, value, borrow); //create a blank new item
+    if (found) {
+        ht_item* cur_item = ht->items[index];
+        ht->value_bytes -= strlen(cur_item->value) + 1;
+        ht->value_bytes += strlen(item->value) + 1;
+        ht->item_bytes -= ht_item_size(ht, cur_item);
+        ht->item_bytes += ht_item_size(ht, item);
+        ht_delete_item(cur_item);
+        ht->items[index] = item;
+    } else {
+        ht_occupy(ht, index, item, probes);
+    }
+    HT_TIMER_STOP(timer, insert_cycles);
+}
+
+//Returns the item holding key, first adding key with value when it is missing, and sets *inserted (if not NULL) to
+//say which happened. For HT_LAYOUT_OPEN tables both cases cost one probe sequence and one hash of the key, where
+//ht_search followed by ht_insert would pay twice. The item stays valid until the table is next modified: its value
+//may be edited in place as long as its length does not change, except when the item has HT_ITEM_BORROWED_VALUE set,
+//as the string is then someone else's (the caller's, or a read-only mapping). ht_upsert is the way to replace it.
+ht_item* ht_find_or_insert(ht_hash_table* ht, const char* key, const char* value, int* inserted){
+    int found = 0;
+    ht_item* item;
+    if (ht->layout != HT_LAYOUT_OPEN) {
+        //the other layouts keep their probes within a few buckets, so looking twice on a miss is cheap
+        ht_sketch_key(ht, key);
+        item = ht->layout == HT_LAYOUT_CUCKOO ? ht_cuckoo_lookup(ht, key) : ht_hopscotch_lookup(ht, key);
+        found = item != NULL;
+        if (!found) {
+            ht_layout_insert(ht, key, value, ht->borrow);
+            item = ht->layout == HT_LAYOUT_CUCKOO ? ht_cuckoo_lookup(ht, key) : ht_hopscotch_lookup(ht, key);
+        }
+    } else {
+        HT_COUNT(inserts, 1);
+        ht_make_room(ht);
+        int probes;
+        const int index = ht_find_slot(ht, key, &found, &probes);
+        HT_COUNT(insert_probes, probes);
+        if (found) {
+            item = ht->items[index];
+        } else {
+            item = ht_new_item(key, value, ht->borrow);
+            ht_occupy(ht, index, item, probes);
+        }
+    }
+    if (inserted != NULL) {
+        *inserted = !found;
+    }
+    return item;
+}
+
+//swaps the value fn returned into item, fixing up value_bytes; old_bytes is the size of the value before fn ran
+static void ht_set_value(ht_hash_table* ht, ht_item* item, char* value, const size_t old_bytes){
+    if (value != item->value) {
+        if (!(item->flags & HT_ITEM_BORROWED_VALUE)) {
+            free(item->value);
+        }
+        item->value = value;
+        item->flags &= ~(HT_ITEM_BORROWED_VALUE | HT_ITEM_PACKED_VALUE); //fn's malloc'd string is the table's to free
+    }
+    ht->value_bytes -= old_bytes;
+    ht->value_bytes += strlen(value) + 1;
+}
+
+//Read-modify-write of key's value through fn (see ht_upsert_fn), such as bumping a counter, in one probe sequence
+//with one hash of the key on HT_LAYOUT_OPEN tables. Returns the value stored for key afterwards, NULL if there is none.
+char* ht_upsert(ht_hash_table* ht, const char* key, ht_upsert_fn fn, void* ctx){
+    if (ht->layout != HT_LAYOUT_OPEN) {
+        ht_sketch_key(ht, key);
+        ht_item* item = ht->layout == HT_LAYOUT_CUCKOO ? ht_cuckoo_lookup(ht, key) : ht_hopscotch_lookup(ht, key);
+        if (item != NULL) {
+            const size_t old_bytes = strlen(item->value) + 1;
+            char* value = fn(item->key, item->value, ctx);
+            if (value != NULL) {
+                ht_set_value(ht, item, value, old_bytes);
+            }
+            return item->value;
+        }
+        char* value = fn(key, NULL, ctx);
+        if (value != NULL) {
+            ht_layout_insert(ht, key, value, ht->borrow & ~HT_ITEM_BORROWED_VALUE); //fn's string is freed below
+            free(value);
+            return ht_search(ht, key);
         }
-        index = ht_get_hash(item->key, ht->size, i);
-        cur_item = ht->items[index];
+        return NULL;
+    }
+    HT_COUNT(inserts, 1);
+    ht_make_room(ht);
+    int found;
+    int probes;
+    const int index = ht_find_slot(ht, key, &found, &probes);
+    HT_COUNT(insert_probes, probes);
+    if (found) {
+        ht_item* item = ht->items[index];
+        const size_t old_bytes = strlen(item->value) + 1;
+        char* value = fn(item->key, item->value, ctx);
+        if (value != NULL) {
+            ht_set_value(ht, item, value, old_bytes);
+        }
+        return item->value;
+    }
+    char* value = fn(key, NULL, ctx);
+    if (value == NULL) {
+        return NULL;
+    }
+    ht_item* item = ht_malloc(sizeof(ht_item));
+    item->key = (ht->borrow & HT_ITEM_BORROWED_KEY) ? (char*)key : ht_strdup(key);
+    item->value = value;
+    item->flags = ht->borrow & HT_ITEM_BORROWED_KEY;
+    ht_occupy(ht, index, item, probes);
+    return item->value;
+}
+
+//Places an item the caller built itself, such as a cache entry embedding an ht_item, in an HT_LAYOUT_OPEN table.
+//The key must not be in the table yet, so the probe stops at the first free or deleted bucket without comparing keys.
+//The item is marked HT_ITEM_EMBEDDED, ht_shrink_to_fit leaves it where the caller put it.
+void ht_insert_item(ht_hash_table* ht, ht_item* item){
+    item->flags |= HT_ITEM_EMBEDDED;
+    ht_make_room(ht);
+    const uint64_t hash = ht_hash(ht, item->key);
+    if (ht->filter != NULL) {
+        ht_bloom_add(ht->filter, hash);
+    }
+    ht_probe probe = ht_probe_at(hash, ht->size);
+    int index = probe.index;
+    int i = 1;
+    while (ht->items[index] != NULL && ht->items[index] != &HT_DELETED_ITEM) {
+        index = ht_probe_next(&probe);
         i++;
-    } 
-    //add new item to the hash table once an index has been found
-    ht->items[index] = item;
-    ht->count++; //increment counter for amount of entries in the hash table
+    }
+    ht_occupy(ht, index, item, i);
 }
 
 //Searching is similar to inserting, but at each iteration of the while loop, we check whether the item's key matches the key we're searching for. 
 //If it does, we return the item's value. If the while loop hits a NULL bucket, we return NULL, to indicate that no value was found.
 char* ht_search(ht_hash_table* ht, const char* key){
-    int index = ht_get_hash(key, ht->size, 0);
+    if (ht->layout == HT_LAYOUT_CUCKOO) {
+        return ht_cuckoo_search(ht, key);
+    }
+    if (ht->layout == HT_LAYOUT_HOPSCOTCH) {
+        return ht_hopscotch_search(ht, key);
+    }
+    ht_item* item = ht_search_item(ht, key);
+    return item != NULL ? item->value : NULL;
+}
+
+//ht_search_item continuing from a probe already started for key
+static ht_item* ht_search_from(ht_hash_table* ht, const char* key, ht_probe probe) {
+    HT_TIMER_START(timer);
+    HT_COUNT(searches, 1);
+    int index = probe.index;
     ht_item* item = ht->items[index];
     int i = 1;
     while (item != NULL) {
         if (item != &HT_DELETED_ITEM) { 
             //check if the current key matches the search key
             if (strcmp(item->key, key) == 0) {
-                return item->value;
+                if (i > HT_FLOOD_PROBES) {
+                    ht->flood_suspected = 1; //colliding keys that made it in are as telling as a long miss
+                }
+                if ((item->flags & HT_ITEM_TTL) && ht_timer_expired(ht->wheel, item)) {
+                    //expired but not swept yet, remove it now rather than hand out a stale value
+                    ht_remove_at(ht, index);
+                    ht->miss_probes[ht_probe_bucket(i)]++;
+                    HT_COUNT(search_probes, i);
+                    HT_TIMER_STOP(timer, search_cycles);
+                    return NULL;
+                }
+                ht->hit_probes[ht_probe_bucket(i)]++;
+                HT_COUNT(search_probes, i);
+                HT_TIMER_STOP(timer, search_cycles);
+                return item;
             }
         }
-        index = ht_get_hash(key, ht->size, i);
+        index = ht_probe_next(&probe);
         item = ht->items[index];
         i++;
     } 
+    ht->miss_probes[ht_probe_bucket(i)]++;
+    if (i > HT_FLOOD_PROBES) {
+        ht->flood_suspected = 1; //lookups must not move items under the caller, leave the rebuild to ht_insert
+    }
+    HT_COUNT(search_probes, i);
+    HT_TIMER_STOP(timer, search_cycles);
+    return NULL;
+}
+
+//whether the filter, if the table has one, rules key out without probing, in which case the miss is counted
+static int ht_filter_rejects(ht_hash_table* ht, const uint64_t hash){
+    if (ht->filter == NULL || ht_bloom_may_contain(ht->filter, hash)) {
+        return 0;
+    }
+    ht->filter_rejects++;
+    return 1;
+}
+
+//the lookup behind ht_search for HT_LAYOUT_OPEN tables, returns the item itself rather than its value
+ht_item* ht_search_item(ht_hash_table* ht, const char* key){
+    return ht_search_hashed(ht, key, ht_hash(ht, key));
+}
+
+//ht_search_item for a caller that already has ht_hash(ht, key)
+ht_item* ht_search_hashed(ht_hash_table* ht, const char* key, const uint64_t hash){
+    if (ht_filter_rejects(ht, hash)) {
+        return NULL;
+    }
+    return ht_search_from(ht, key, ht_probe_at(hash, ht->size));
+}
+
+
+//Looks up n keys at once, setting values[i] to what ht_search(ht, keys[i]) would return.
+//On HT_LAYOUT_OPEN tables a group of keys is hashed and the buckets they start at are prefetched, then the items in
+//those buckets, before any key is compared, so the cache misses of a multiget overlap rather than queue up.
+void ht_search_batch(ht_hash_table* ht, const char* const* keys, const int n, char** values) {
+    if (ht->layout != HT_LAYOUT_OPEN) {
+        for (int i = 0; i < n; i++) {
+            values[i] = ht_search(ht, keys[i]);
+        }
+        return;
+    }
+    ht_probe probes[HT_SEARCH_BATCH];
+    int rejected[HT_SEARCH_BATCH];
+    for (int first = 0; first < n; first += HT_SEARCH_BATCH) {
+        const int group = n - first < HT_SEARCH_BATCH ? n - first : HT_SEARCH_BATCH;
+        for (int i = 0; i < group; i++) {
+            const uint64_t hash = ht_hash(ht, keys[first + i]);
+            rejected[i] = ht_filter_rejects(ht, hash);
+            probes[i] = ht_probe_at(hash, ht->size);
+            if (!rejected[i]) {
+                __builtin_prefetch(&ht->items[probes[i].index]);
+            }
+        }
+        for (int i = 0; i < group; i++) {
+            const ht_item* item = rejected[i] ? NULL : ht->items[probes[i].index];
+            if (item != NULL && item != &HT_DELETED_ITEM) {
+                __builtin_prefetch(item);
+                __builtin_prefetch(item->key);
+            }
+        }
+        for (int i = 0; i < group; i++) {
+            ht_item* item = rejected[i] ? NULL : ht_search_from(ht, keys[first + i], probes[i]);
+            values[first + i] = item != NULL ? item->value : NULL;
+        }
+    }
+}
+
+//Read-only lookup for an HT_LAYOUT_OPEN table that another thread may be adding keys to, as long as that thread
+//never deletes, replaces or makes the table resize. Slots are read with acquire loads pairing with the release store
+//in ht_occupy, and unlike ht_search_item nothing is written, not even the probe statistics.
+ht_item* ht_search_shared(const ht_hash_table* ht, const char* key){
+    ht_probe probe = ht_probe_start(ht, key, ht->size);
+    int index = probe.index;
+    ht_item* item = __atomic_load_n(&ht->items[index], __ATOMIC_ACQUIRE);
+    while (item != NULL) {
+        if (item != &HT_DELETED_ITEM && strcmp(item->key, key) == 0) {
+            return item;
+        }
+        index = ht_probe_next(&probe);
+        item = __atomic_load_n(&ht->items[index], __ATOMIC_ACQUIRE);
+    }
     return NULL;
 }
 
 //The item we wish to delete may be part of a collision chain. Removing it from the table will break that chain, and will make finding items in the tail of the chain impossible. To solve this, instead of deleting the item, we simply mark it as deleted.
 //We mark an item as deleted by replacing it with a pointer to a global sentinel item which represents that a bucket contains a deleted item.
-void ht_delete(ht_hash_table* ht, const char* key){
-    const int load = ht->count * 100 / ht->size;
-    if (load < 10) {
+//Returns 1 if key was there to delete, 0 if it was missing (or had already expired).
+int ht_delete(ht_hash_table* ht, const char* key){
+    if (ht->layout == HT_LAYOUT_CUCKOO) {
+        return ht_cuckoo_delete(ht, key);
+    }
+    if (ht->layout == HT_LAYOUT_HOPSCOTCH) {
+        return ht_hopscotch_delete(ht, key);
+    }
+    HT_TIMER_START(timer);
+    HT_COUNT(deletes, 1);
+    if ((long long)ht->count * 100 / ht->size < 10 && ht->base_size > ht->reserved_base) {
         ht_resize_down(ht);
     }
-    int index = ht_get_hash(key, ht->size, 0);
+    const uint64_t hash = ht_hash(ht, key);
+    if (ht_filter_rejects(ht, hash)) {
+        HT_TIMER_STOP(timer, delete_cycles);
+        return 0;
+    }
+    ht_probe probe = ht_probe_at(hash, ht->size);
+    int index = probe.index;
     ht_item* item = ht->items[index];
     int i = 1;
     while (item != NULL) {
         if (item != &HT_DELETED_ITEM) {
             if (strcmp(item->key, key) == 0) {
-                ht_del_item(item);
-                ht->items[index] = &HT_DELETED_ITEM;
+                if (i > HT_FLOOD_PROBES) {
+                    ht->flood_suspected = 1;
+                }
+                const int live = !(item->flags & HT_ITEM_TTL) || !ht_timer_expired(ht->wheel, item);
+                ht_remove_at(ht, index);
+                HT_COUNT(delete_probes, i);
+                HT_TIMER_STOP(timer, delete_cycles);
+                return live;
             }
         }
-        index = ht_get_hash(key, ht->size, i);
+        index = ht_probe_next(&probe);
         item = ht->items[index];
         i++;
     } 
-    ht->count--; 
+    if (i > HT_FLOOD_PROBES) {
+        ht->flood_suspected = 1;
+    }
+    HT_COUNT(delete_probes, i);
+    HT_TIMER_STOP(timer, delete_cycles);
+    return 0;
+}
+
+//puts an item into the first empty bucket of its probe sequence, only used to fill a freshly built bucket array
+static void ht_place_item(ht_hash_table* ht, ht_item* item) {
+    const uint64_t hash = ht_hash(ht, item->key);
+    if (ht->filter != NULL) {
+        ht_bloom_add(ht->filter, hash);
+    }
+    ht_probe probe = ht_probe_at(hash, ht->size);
+    int index = probe.index;
+    while (ht->items[index] != NULL) {
+        index = ht_probe_next(&probe);
+    }
+    ht->items[index] = item;
+}
+
+//Inserts key with an expiry ttl_seconds from now, replacing any existing value and expiry.
+//Expired items vanish from ht_search straight away and are freed either by that lookup or by ht_expire.
+//Only HT_LAYOUT_OPEN tables track expiry, the other layouts store the pair without one.
+void ht_insert_ttl(ht_hash_table* ht, const char* key, const char* value, const int ttl_seconds) {
+    if (ht->layout != HT_LAYOUT_OPEN) {
+        ht_insert(ht, key, value);
+        return;
+    }
+    if (ht->wheel == NULL) {
+        ht->wheel = ht_timer_wheel_new();
+    }
+    ht_delete(ht, key);
+    ht_sketch_key(ht, key);
+    ht_insert_item(ht, ht_timer_new_item(ht->wheel, key, value, ttl_seconds));
+}
+
+//Frees up to max_items expired items, walking only the timer wheel slots that have come due since the last call.
+//Meant to be called periodically, the bound keeps each call's pause short. Returns how many items were freed.
+int ht_expire(ht_hash_table* ht, const int max_items) {
+    if (ht->wheel == NULL) {
+        return 0;
+    }
+    return ht_timer_advance(ht, max_items);
+}
+
+//ht_place_item for several threads filling the same new slot array, a slot is claimed with a compare and swap
+//and whoever loses the race moves on along its probe sequence
+static void ht_place_item_shared(ht_hash_table* ht, ht_item* item) {
+    const uint64_t hash = ht_hash(ht, item->key);
+    if (ht->filter != NULL) {
+        ht_bloom_add_shared(ht->filter, hash);
+    }
+    ht_probe probe = ht_probe_at(hash, ht->size);
+    int index = probe.index;
+    for (;;) {
+        ht_item* expected = NULL;
+        if (__atomic_load_n(&ht->items[index], __ATOMIC_RELAXED) == NULL &&
+            __atomic_compare_exchange_n(&ht->items[index], &expected, item, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return;
+        }
+        index = ht_probe_next(&probe);
+    }
+}
+
+typedef struct {
+    ht_hash_table* old_ht;
+    ht_hash_table* new_ht;
+} ht_rehash_job;
+
+//moves the items of one chunk of the old slot array, ht_pool_run returning orders every claim before the swap
+static void ht_rehash_chunk(void* ctx, const size_t begin, const size_t end, const int worker) {
+    (void)worker;
+    const ht_rehash_job* job = ctx;
+    for (size_t i = begin; i < end; i++) {
+        ht_item* item = job->old_ht->items[i];
+        if (item != NULL && item != &HT_DELETED_ITEM) {
+            ht_place_item_shared(job->new_ht, item);
+        }
+    }
 }
 
 static void ht_resize(ht_hash_table* ht, const int base_size) {
     if (base_size < HT_INITIAL_BASE_SIZE) {
         return;
     }
+    HT_TIMER_START(timer);
+    HT_COUNT(resizes, 1);
+    HT_COUNT(resize_items_moved, ht->count);
     ht_hash_table* new_ht = ht_new_sized(base_size);
-    for (int i = 0; i < ht->size; i++) {
-        ht_item* item = ht->items[i];
-        if (item != NULL && item != &HT_DELETED_ITEM) {
-            ht_insert(new_ht, item->key, item->value);
+    ht_inherit_config(new_ht, ht);
+    if (ht->filter != NULL) {
+        new_ht->filter = ht_filter_new(new_ht->size); //filled as the items are placed, under the same hash
+    }
+    //items are moved rather than copied, so they are never reallocated and anything embedding an ht_item keeps its links
+    if (ht->resize_pool != NULL && ht->count >= HT_PARALLEL_RESIZE_MIN) {
+        ht_rehash_job job = {ht, new_ht};
+        ht_pool_run(ht->resize_pool, (size_t)ht->size, HT_PARALLEL_CHUNK, ht_rehash_chunk, &job);
+    } else {
+        for (int i = 0; i < ht->size; i++) {
+            ht_item* item = ht->items[i];
+            if (item != NULL && item != &HT_DELETED_ITEM) {
+                ht_place_item(new_ht, item);
+            }
         }
     }
 
     ht->base_size = new_ht->base_size;
-    ht->count = new_ht->count;
+    ht->tombstones = 0; //rebuilding drops every tombstone
+    if (ht->filter != NULL) {
+        ht_filter_free(ht->filter);
+        ht->filter = new_ht->filter;
+        ht->filter_stale = 0;
+    }
+    ht_moved_all(ht);
 
     // To delete new_ht, we give it ht's size and items 
     const int tmp_size = ht->size;
@@ -190,16 +1016,259 @@ static void ht_resize(ht_hash_table* ht, const int base_size) {
     ht->items = new_ht->items;
     new_ht->items = tmp_items;
 
-    ht_del_hash_table(new_ht);
+    //the items now belong to ht, so only the old bucket array and new_ht itself are freed
+    ht_slots_free(new_ht->items);
+    free(new_ht);
+    HT_TIMER_STOP(timer, resize_cycles);
 }   
 
 static void ht_resize_up(ht_hash_table* ht) {
-    const int new_size = ht->base_size * 2;
+    if (ht->base_size >= HT_MAX_BASE_SIZE) {
+        return;
+    }
+    const int new_size = ht->base_size > HT_MAX_BASE_SIZE / 2 ? HT_MAX_BASE_SIZE : ht->base_size * 2;
     ht_resize(ht, new_size);
 }
 
 
 static void ht_resize_down(ht_hash_table* ht) {
-    const int new_size = ht->base_size / 2;
+    const int new_size = ht->base_size / 2 > ht->reserved_base ? ht->base_size / 2 : ht->reserved_base;
     ht_resize(ht, new_size);
-}
\ No newline at end of file
+}
+
+//Called when a probe sequence ran past HT_FLOOD_PROBES. Either the keys were picked to collide under the fixed primes
+//or a skewed key set defeats the current seed, so switch to SipHash under a fresh seed and rebuild the buckets in place.
+//A table already on SipHash only rebuilds again after count / 4 more inserts, which keeps the rebuild cost amortized O(1).
+static void ht_reseed(ht_hash_table* ht) {
+    ht->flood_suspected = 0;
+    if (ht->hash_mode == HT_HASH_SIPHASH && ht->inserts_since_reseed < ht->count / 4) {
+        return;
+    }
+    ht->hash_mode = HT_HASH_SIPHASH;
+    ht_random_seed(ht->seed);
+    ht->reseeds++;
+    ht->inserts_since_reseed = 0;
+    ht_resize(ht, ht->base_size);
+}
+
+//fills out with a snapshot of the table's size, memory use and probe histograms
+//nothing here walks the table, so it is cheap enough to export to a metrics system every few seconds
+void ht_stats(const ht_hash_table* ht, ht_statistics* out){
+    out->count = ht->count;
+    out->tombstones = ht->tombstones;
+    out->reseeds = ht->reseeds;
+    out->size = ht->size;
+    out->load_factor = (double)(ht->count + ht->tombstones) / ht->size;
+    out->slot_bytes = (size_t)ht->size * sizeof(ht_item*);
+    out->slot_page_size = ht_slots_page_size(ht->items);
+    out->item_bytes = ht->item_bytes;
+    out->key_bytes = ht->key_bytes;
+    out->value_bytes = ht->value_bytes;
+    memcpy(out->hit_probes, ht->hit_probes, sizeof(out->hit_probes));
+    memcpy(out->miss_probes, ht->miss_probes, sizeof(out->miss_probes));
+    out->filter_bytes = ht->filter != NULL ? ht_bloom_bytes(ht->filter) : 0;
+    out->filter_rejects = ht->filter_rejects;
+}
+
+//whether the slot holds an entry an iterator should hand out: not empty, not a tombstone and not expired
+static int ht_slot_live(const ht_hash_table* ht, const ht_item* item){
+    if (item == NULL || item == &HT_DELETED_ITEM) {
+        return 0;
+    }
+    return !(item->flags & HT_ITEM_TTL) || !ht_timer_expired(ht->wheel, item);
+}
+
+//Layouts call this after moving a live item from slot from (-1 for one that was not in the table) to slot to.
+//Only a move to a lower slot that a scan cursor has already passed can hide the item from that walk.
+void ht_moved(ht_hash_table* ht, const int from, const int to){
+    if (to < from && to < ht->scan_mark) {
+        ht_moved_all(ht);
+    }
+}
+
+//called after a rebuild that may have moved every item, sends any walk in progress back to slot 0
+void ht_moved_all(ht_hash_table* ht){
+    ht->resize_epoch++;
+    ht->scan_mark = 0;
+}
+
+//Starts a walk over every live entry, in slot order, for any layout.
+//The table must not be modified until the walk is over, use ht_scan when it has to keep changing.
+void ht_iter_begin(ht_hash_table* ht, ht_iter* it){
+    it->ht = ht;
+    it->index = 0;
+}
+
+//Sets key and value to the next live entry and returns 1, or returns 0 once every slot has been visited.
+//The items a few slots ahead are prefetched so the walk is bound by memory bandwidth rather than latency.
+int ht_iter_next(ht_iter* it, const char** key, const char** value){
+    const ht_hash_table* ht = it->ht;
+    while (it->index < ht->size) {
+        if (it->index + HT_ITER_PREFETCH < ht->size) {
+            __builtin_prefetch(ht->items[it->index + HT_ITER_PREFETCH]);
+        }
+        const ht_item* item = ht->items[it->index];
+        it->index++;
+        if (ht_slot_live(ht, item)) {
+            *key = item->key;
+            *value = item->value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//Incremental walk in the style of Redis SCAN: start with cursor 0, pass each returned cursor back in, stop when 0
+//comes back. Each call looks at about count slots and passes their live entries to fn, and the table may be freely
+//modified between calls. Every entry present for the whole walk is passed to fn at least once.
+//Redis gets that guarantee from a reverse binary cursor over power of two chained buckets, which does not carry over
+//to open addressing with prime sizes: a resize moves every entry. Instead the cursor records the resize epoch it was
+//issued under and a walk that sees the epoch change starts again from slot 0, so entries may be reported twice.
+//A table that keeps resizing (or, for cuckoo and hopscotch, moving items behind the cursor) faster than the walk
+//advances can therefore keep it from ever finishing. The table tracks one walk at a time: a second walk run
+//alongside shares its progress mark, which the first one to finish clears. A count below 1 is taken as 1.
+unsigned long long ht_scan(ht_hash_table* ht, const unsigned long long cursor, const int count, ht_scan_fn fn, void* ctx){
+    const int step = count > 0 ? count : 1; //0 would look at nothing and hand back cursor 0, as if the walk were over
+    const unsigned long long epoch = ht->resize_epoch & ((1ULL << (64 - HT_SCAN_EPOCH_SHIFT)) - 1);
+    int index = 0;
+    if (cursor != 0 && (cursor >> HT_SCAN_EPOCH_SHIFT) == epoch) {
+        index = (int)(cursor & ((1ULL << HT_SCAN_EPOCH_SHIFT) - 1));
+    }
+    const int end = ht->size - index > step ? index + step : ht->size;
+    for (; index < end; index++) {
+        if (index + HT_ITER_PREFETCH < end) {
+            __builtin_prefetch(ht->items[index + HT_ITER_PREFETCH]);
+        }
+        const ht_item* item = ht->items[index];
+        if (ht_slot_live(ht, item)) {
+            fn(item->key, item->value, ctx);
+        }
+    }
+    if (index >= ht->size) {
+        ht->scan_mark = 0; //the walk is over, moves no longer need to restart anything
+        return 0;
+    }
+    if (index > ht->scan_mark) {
+        ht->scan_mark = index;
+    }
+    return (epoch << HT_SCAN_EPOCH_SHIFT) | (unsigned long long)index;
+}
+
+typedef struct {
+    ht_hash_table* ht;
+    ht_for_each_fn fn;
+    char* locals;
+    size_t stride; //bytes between workers' reducer states, a whole number of cache lines
+} ht_for_each_job;
+
+static void ht_for_each_chunk(void* ctx, const size_t begin, const size_t end, const int worker){
+    const ht_for_each_job* job = ctx;
+    const ht_hash_table* ht = job->ht;
+    void* local = job->locals != NULL ? job->locals + (size_t)worker * job->stride : NULL;
+    for (size_t i = begin; i < end; i++) {
+        if (i + HT_ITER_PREFETCH < end) {
+            __builtin_prefetch(ht->items[i + HT_ITER_PREFETCH]);
+        }
+        const ht_item* item = ht->items[i];
+        if (ht_slot_live(ht, item)) {
+            job->fn(item->key, item->value, local);
+        }
+    }
+}
+
+//Lets resizes of the open addressing layout spread the rehash over pool's threads once the table holds at least
+//HT_PARALLEL_RESIZE_MIN items, NULL goes back to rehashing on the calling thread. The pool must outlive the setting.
+void ht_set_resize_pool(ht_hash_table* ht, ht_thread_pool* pool){
+    ht->resize_pool = pool;
+}
+
+//Attaches a key sketch (see sketch.h) that every key given to ht_insert, ht_insert_borrowed, ht_insert_ttl,
+//ht_find_or_insert or ht_upsert is counted in, for distinct key and heavy hitter estimates without keeping the keys.
+//It is fed the hash the insert computes anyway. A reseed after a collision flood changes every key's hash, so counts
+//from before it no longer line up with the keys. NULL detaches; the sketch must outlive the setting.
+void ht_set_key_sketch(ht_hash_table* ht, struct ht_key_sketch* sketch){
+    ht->key_sketch = sketch;
+}
+
+//Faults in every page of the slot array now, split across pool's threads (NULL for just the calling thread), rather
+//than one page at a time as the first inserts reach them. Large arrays are mapped without being touched (see slots.h),
+//which keeps creating or ht_reserve'ing a table of a billion slots instant, but leaves page faults on the insert
+//path; call this after ht_reserve when predictable latency matters more. Without a NUMA placement (ht_set_numa)
+//the pages land on the nodes of the threads that touch them.
+void ht_prefault(ht_hash_table* ht, ht_thread_pool* pool){
+    ht_slots_prefault(ht->items, pool);
+}
+
+//Places the slot array, now and after every resize, on the NUMA nodes numa names: HT_NUMA_INTERLEAVE for a table
+//read from threads on every node, a node id for one used by threads on that node, HT_NUMA_ANY for the default of
+//wherever the pages are first touched. The slots already in use are migrated. Only arrays large enough to be mapped
+//(see slots.h) are placed, and the items and strings stay wherever malloc put them.
+void ht_set_numa(ht_hash_table* ht, const int numa){
+    ht->numa = numa;
+    ht_slots_place(ht->items, numa, 1);
+}
+
+//a filter sized for the keys a table of size buckets holds before ht_make_room grows it
+static ht_bloom* ht_filter_new(const int size){
+    ht_bloom* filter = ht_malloc(sizeof(ht_bloom));
+    ht_bloom_init(filter, (size_t)size * 70 / 100 + 1);
+    return filter;
+}
+
+static void ht_filter_free(ht_bloom* filter){
+    if (filter != NULL) {
+        ht_bloom_free(filter);
+        free(filter);
+    }
+}
+
+//starts the filter over from the live keys, dropping the bits of every key removed since it was last built
+static void ht_filter_rebuild(ht_hash_table* ht){
+    ht_filter_free(ht->filter);
+    ht->filter = ht_filter_new(ht->size);
+    ht->filter_stale = 0;
+    for (int i = 0; i < ht->size; i++) {
+        const ht_item* item = ht->items[i];
+        if (item != NULL && item != &HT_DELETED_ITEM) {
+            ht_bloom_add(ht->filter, ht_hash(ht, item->key));
+        }
+    }
+}
+
+//Puts a Bloom filter of every key in front of an HT_LAYOUT_OPEN table, so that ht_search, ht_search_batch and
+//ht_delete answer most misses from one cache line instead of walking the probe sequence to an empty bucket. Worth it
+//when most lookups miss: a hit pays for the extra check, and the filter costs 12 bits per key the table can hold.
+//It is resized with the table, and rebuilt from the live keys after size / 8 removals since a Bloom filter cannot
+//drop a key. ht_search_shared does not consult it. 0 frees the filter; the other layouts ignore the setting.
+void ht_set_filter(ht_hash_table* ht, const int enable){
+    if (ht->layout != HT_LAYOUT_OPEN) {
+        return;
+    }
+    if (!enable) {
+        ht_filter_free(ht->filter);
+        ht->filter = NULL;
+    } else if (ht->filter == NULL) {
+        ht_filter_rebuild(ht);
+    }
+}
+
+//Calls fn for every live entry with the slot array split across the pool's threads, for aggregations over tables
+//large enough to be bound by memory bandwidth. Each worker gets a zeroed reducer state of local_size bytes on its
+//own cache lines, and once every slot is done merge folds them into result one at a time on the calling thread.
+//fn runs concurrently on several threads, and the table must not be modified until this returns.
+void ht_parallel_for_each(ht_hash_table* ht, ht_thread_pool* pool, ht_for_each_fn fn, const size_t local_size,
+                          ht_merge_fn merge, void* result){
+    const int threads = ht_pool_threads(pool);
+    ht_for_each_job job = {ht, fn, NULL, (local_size + HT_CACHE_LINE - 1) / HT_CACHE_LINE * HT_CACHE_LINE};
+    if (local_size > 0) {
+        job.locals = ht_aligned_alloc(HT_CACHE_LINE, job.stride * (size_t)threads);
+        memset(job.locals, 0, job.stride * (size_t)threads);
+    }
+    ht_pool_run(pool, (size_t)ht->size, HT_PARALLEL_CHUNK, ht_for_each_chunk, &job);
+    if (job.locals != NULL) {
+        for (int w = 0; w < threads; w++) {
+            merge(result, job.locals + (size_t)w * job.stride);
+        }
+        free(job.locals);
+    }
+}
@@ -14,20 +14,146 @@
 //Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
 //Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
 
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HT_ITEM_TTL 1 //the item is an ht_ttl_item waiting in the table's timer wheel
+#define HT_ITEM_BORROWED_KEY 2 //key points into the caller's memory and is not freed with the item
+#define HT_ITEM_BORROWED_VALUE 4 //same for value
+#define HT_ITEM_PACKED_KEY 8 //key was moved into the table's pack block by ht_shrink_to_fit, also marked borrowed
+#define HT_ITEM_PACKED_VALUE 16 //same for value
+#define HT_ITEM_PACKED 32 //so was the item itself, ht_delete_item leaves it there
+#define HT_ITEM_EMBEDDED 64 //set by ht_insert_item: the item heads a larger struct of the caller's and must not move
+
 //key value pairs associated with the hash table
 typedef struct {
     char* key;
     char* value;
+    int flags; //HT_ITEM_ bits
 } ht_item;
 
+struct ht_timer_wheel;
+struct ht_key_sketch;
+struct ht_bloom;
+struct ht_pack_block;
+struct ht_thread_pool;
+
+//how keys are hashed, chosen per table when it is created
+#define HT_HASH_FAST 0 //polynomial hash with the fixed primes, fastest but anyone who knows them can craft colliding keys
+#define HT_HASH_SIPHASH 1 //SipHash-1-3 keyed with a random per-table seed
+
+//how the slot array is organised, chosen per table when it is created
+#define HT_LAYOUT_OPEN 0 //open addressing with double hashing, the default
+#define HT_LAYOUT_CUCKOO 1 //4-way bucketized cuckoo hashing, lookups read at most two buckets and a small stash
+#define HT_LAYOUT_HOPSCOTCH 2 //hopscotch hashing, every key within 32 slots of its home bucket
+
+//which NUMA nodes the slot array is placed on, see ht_set_numa; any value >= 0 is the id of a node to prefer
+#define HT_NUMA_ANY -1 //wherever the thread touching the pages first runs, the kernel default
+#define HT_NUMA_INTERLEAVE -2 //spread page by page over every node, the same average latency from each one
+
+//probe lengths are bucketed by powers of two: 1, 2, 3-4, 5-8, 9-16, 17-32, 33-64, 65+
+#define HT_PROBE_HIST_BUCKETS 8
+
 //hash table stores: an array of pointers to items, details about size and how full it is
 typedef struct {
     int base_size;
+    int reserved_base; //base size ht_reserve asked for, deletes never shrink the table below it
     int size;
     int count;
+    int layout; //HT_LAYOUT_OPEN or one of the alternative layouts
+    void* engine; //per-layout state of the alternative layouts, NULL for HT_LAYOUT_OPEN
+    int hash_mode; //HT_HASH_FAST or HT_HASH_SIPHASH
+    uint64_t seed[2]; //SipHash key, unused in HT_HASH_FAST mode
+    int tombstones; //buckets holding HT_DELETED_ITEM, these lengthen probe chains until the next resize
+    int reseeds; //times a collision flood made the table rebuild under a new seed
+    int inserts_since_reseed;
+    int flood_suspected; //set by a lookup that probed past HT_FLOOD_PROBES, acted on by the next ht_insert
+    struct ht_timer_wheel* wheel; //expiry of items inserted with ht_insert_ttl, created by the first one
+    unsigned int resize_epoch; //bumped whenever items may move to a slot a scan has already passed
+    int scan_mark; //furthest slot an ht_scan cursor has reached under the current resize_epoch
+    struct ht_thread_pool* resize_pool; //set with ht_set_resize_pool, not owned by the table
+    struct ht_key_sketch* key_sketch; //set with ht_set_key_sketch, not owned by the table
+    struct ht_bloom* filter; //every key added since the last rebuild, checked before probing, see ht_set_filter
+    int filter_stale; //keys removed since the filter was last rebuilt, their bits are still set
+    unsigned long filter_rejects; //lookups and deletes the filter answered without probing
+    struct ht_pack_block* packed; //what ht_shrink_to_fit packed the table's items, keys and values into
+    int numa; //HT_NUMA_ANY, HT_NUMA_INTERLEAVE or a node id, see ht_set_numa
+    int borrow; //HT_ITEM_BORROWED_* flags ht_insert gives every item it creates, see ht_set_borrow
+    size_t key_bytes; //running total of strlen + 1 for every live key and value
+    size_t value_bytes;
+    size_t item_bytes; //running total of ht_item_size for every live item
+    size_t embedded_size; //size of the struct each item given to ht_insert_item heads, set by whoever embeds them
+    unsigned long hit_probes[HT_PROBE_HIST_BUCKETS]; //probe lengths seen by ht_search for present keys
+    unsigned long miss_probes[HT_PROBE_HIST_BUCKETS]; //and for absent keys
     ht_item** items;
 }ht_hash_table;
 
+//walks the live entries of a table, see ht_iter_begin
+typedef struct {
+    ht_hash_table* ht;
+    int index; //next slot to look at
+} ht_iter;
+
+//called by ht_scan for each entry
+typedef void (*ht_scan_fn)(const char* key, const char* value, void* ctx);
+
+//Called by ht_upsert with the key's current value, NULL when it is missing. Returns the value to store: the same
+//pointer after editing the string in place without lengthening it, a new string from malloc that the table takes
+//over (freeing the old one), or NULL to leave the table as it was.
+typedef char* (*ht_upsert_fn)(const char* key, char* value, void* ctx);
+
+//called by ht_parallel_for_each for each entry, local is the calling worker's own reducer state
+typedef void (*ht_for_each_fn)(const char* key, const char* value, void* local);
+//folds one worker's reducer state into the overall result
+typedef void (*ht_merge_fn)(void* result, const void* local);
+
+//snapshot returned by ht_stats, everything in here is maintained incrementally so taking one is O(1)
+typedef struct {
+    int count;
+    int tombstones;
+    int reseeds;
+    int size;
+    double load_factor; //(count + tombstones) / size, tombstones occupy buckets just like live items
+    size_t slot_bytes;
+    size_t slot_page_size; //4KB unless the slot array got hugetlb pages, see slots.h
+    size_t item_bytes; //each item as the ht_item, ht_ttl_item or embedding struct it really is
+    size_t key_bytes;
+    size_t value_bytes;
+    unsigned long hit_probes[HT_PROBE_HIST_BUCKETS];
+    unsigned long miss_probes[HT_PROBE_HIST_BUCKETS]; //only misses that got past the filter, if there is one
+    size_t filter_bytes;
+    unsigned long filter_rejects;
+} ht_statistics;
+
+ht_hash_table* ht_new();
+ht_hash_table* ht_new_seeded();
+ht_hash_table* ht_new_layout(const int layout);
+void ht_delete_hash_table(ht_hash_table* ht);
+void ht_reserve(ht_hash_table* ht, const int count);
+void ht_shrink_to_fit(ht_hash_table* ht);
 void ht_insert(ht_hash_table* ht, const char* key, const char* value);
+void ht_insert_borrowed(ht_hash_table* ht, const char* key, const char* value, const int borrow);
+void ht_set_borrow(ht_hash_table* ht, const int borrow);
 char* ht_search(ht_hash_table* ht, const char* key);
-void ht_delete(ht_hash_table* ht, const char* key);
\ No newline at end of file
+void ht_search_batch(ht_hash_table* ht, const char* const* keys, const int n, char** values);
+int ht_delete(ht_hash_table* ht, const char* key);
+ht_item* ht_find_or_insert(ht_hash_table* ht, const char* key, const char* value, int* inserted);
+char* ht_upsert(ht_hash_table* ht, const char* key, ht_upsert_fn fn, void* ctx);
+void ht_insert_ttl(ht_hash_table* ht, const char* key, const char* value, const int ttl_seconds);
+int ht_expire(ht_hash_table* ht, const int max_items);
+void ht_stats(const ht_hash_table* ht, ht_statistics* out);
+void ht_set_resize_pool(ht_hash_table* ht, struct ht_thread_pool* pool);
+void ht_set_key_sketch(ht_hash_table* ht, struct ht_key_sketch* sketch);
+void ht_set_filter(ht_hash_table* ht, const int enable);
+void ht_set_numa(ht_hash_table* ht, const int numa);
+void ht_prefault(ht_hash_table* ht, struct ht_thread_pool* pool);
+void ht_iter_begin(ht_hash_table* ht, ht_iter* it);
+int ht_iter_next(ht_iter* it, const char** key, const char** value);
+unsigned long long ht_scan(ht_hash_table* ht, const unsigned long long cursor, const int count, ht_scan_fn fn, void* ctx);
+void ht_parallel_for_each(ht_hash_table* ht, struct ht_thread_pool* pool, ht_for_each_fn fn, size_t local_size,
+                          ht_merge_fn merge, void* result);
+
+#endif
@@ -0,0 +1,44 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#ifndef HASH_TABLE_INTERNAL_H
+#define HASH_TABLE_INTERNAL_H
+
+//helpers hash_table.c shares with the alternative table layouts, not part of the public API
+
+#include "hash_table.h"
+
+#define HT_CACHE_LINE 64 //for padding data that different threads write apart
+#define HT_MAX_BASE_SIZE 2000000000 //the next prime up, 2000000011, still fits the int slot count
+
+void* ht_malloc(const size_t size);
+void* ht_calloc(const size_t count, const size_t size);
+char* ht_strdup(const char* s);
+void* ht_aligned_alloc(const size_t alignment, const size_t size);
+ht_item* ht_new_item(const char* k, const char* v, const int borrow);
+void ht_delete_item(ht_item* i);
+size_t ht_item_size(const ht_hash_table* ht, const ht_item* item);
+ht_item* ht_search_item(ht_hash_table* ht, const char* key);
+ht_item* ht_search_hashed(ht_hash_table* ht, const char* key, const uint64_t hash);
+ht_item* ht_search_shared(const ht_hash_table* ht, const char* key);
+void ht_insert_item(ht_hash_table* ht, ht_item* item);
+uint64_t ht_hash(const ht_hash_table* ht, const char* s);
+uint64_t ht_fast_hash(const char* s);
+void ht_random_seed(uint64_t seed[2]);
+void ht_moved(ht_hash_table* ht, int from, int to);
+void ht_moved_all(ht_hash_table* ht);
+
+#endif
@@ -0,0 +1,288 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hopscotch.h"
+#include "hash_table_internal.h"
+#include "instrument.h"
+#include "prime.h"
+#include "slots.h"
+
+//Slots live in ht->items like every other layout. The array has HT_HOP_RANGE - 1 slots past the last home bucket
+//so a neighbourhood never wraps around, which keeps a lookup to one or two contiguous cache lines of slots.
+typedef struct {
+    int num_buckets;
+    uint32_t* hops; //bit i of hops[b] set: the slot b + i holds a key whose home bucket is b
+    unsigned int version; //odd while a displacement is moving keys between slots
+} ht_hopscotch;
+
+static int ht_hopscotch_home(const ht_hash_table* ht, const ht_hopscotch* h, const char* key) {
+    return (int)((ht_hash(ht, key) & 0xffffffff) % (uint64_t)h->num_buckets);
+}
+
+static void ht_hopscotch_alloc(ht_hash_table* ht, ht_hopscotch* h, const int num_buckets) {
+    h->num_buckets = num_buckets;
+    h->hops = ht_calloc((size_t)num_buckets, sizeof(uint32_t));
+    ht->base_size = num_buckets;
+    ht->size = num_buckets + HT_HOP_RANGE - 1;
+    ht->items = ht_slots_alloc((size_t)ht->size);
+    if (ht->numa != HT_NUMA_ANY) {
+        ht_slots_place(ht->items, ht->numa, 0);
+    }
+}
+
+//Finds a free slot within HT_HOP_ADD_RANGE of home, then hops it back towards home by moving keys that may
+//legally sit further from their own home bucket, until the free slot is inside home's neighbourhood.
+//Returns the slot or -1 when no free slot could be brought close enough, in which case the table must grow.
+static int ht_hopscotch_free_slot(ht_hash_table* ht, ht_hopscotch* h, const int home) {
+    int end = home + HT_HOP_ADD_RANGE;
+    if (end > ht->size) {
+        end = ht->size;
+    }
+    int free_slot = home;
+    while (free_slot < end && ht->items[free_slot] != NULL) {
+        free_slot++;
+    }
+    if (free_slot == end) {
+        return -1;
+    }
+    while (free_slot - home >= HT_HOP_RANGE) {
+        int moved = 0;
+        const int last = free_slot < h->num_buckets ? free_slot : h->num_buckets; //slots past the last bucket are no home
+        for (int b = free_slot - HT_HOP_RANGE + 1; b < last && !moved; b++) {
+            const uint32_t hops = h->hops[b];
+            if (hops == 0) {
+                continue;
+            }
+            const int i = __builtin_ctz(hops); //the key closest to b gives the longest hop
+            const int from = b + i;
+            if (from >= free_slot) {
+                continue;
+            }
+            //readers that overlap this window retry, they could otherwise miss the key while it is between slots
+            __atomic_store_n(&h->version, h->version + 1, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            __atomic_store_n(&ht->items[free_slot], ht->items[from], __ATOMIC_RELAXED);
+            __atomic_store_n(&h->hops[b], (hops | (1u << (free_slot - b))) & ~(1u << i), __ATOMIC_RELAXED);
+            __atomic_store_n(&ht->items[from], NULL, __ATOMIC_RELAXED);
+            __atomic_store_n(&h->version, h->version + 1, __ATOMIC_RELEASE);
+            free_slot = from;
+            moved = 1;
+        }
+        if (!moved) {
+            return -1;
+        }
+    }
+    return free_slot;
+}
+
+//adds an item known not to be in the table, returns 0 if it did not fit
+static int ht_hopscotch_add(ht_hash_table* ht, ht_hopscotch* h, ht_item* item) {
+    const int home = ht_hopscotch_home(ht, h, item->key);
+    const int slot = ht_hopscotch_free_slot(ht, h, home);
+    if (slot < 0) {
+        return 0;
+    }
+    //publish the item before the bit that makes readers look at it
+    __atomic_store_n(&ht->items[slot], item, __ATOMIC_RELEASE);
+    __atomic_store_n(&h->hops[home], h->hops[home] | (1u << (slot - home)), __ATOMIC_RELEASE);
+    return 1;
+}
+
+//Re-adds every item plus extra into a new slot array, doubling num_buckets until they all fit.
+static void ht_hopscotch_rebuild(ht_hash_table* ht, int num_buckets, ht_item* extra) {
+    ht_hopscotch* h = ht->engine;
+    ht_item** all = ht_malloc(sizeof(ht_item*) * ((size_t)ht->count + 1));
+    int n = 0;
+    for (int i = 0; i < ht->size; i++) {
+        if (ht->items[i] != NULL) {
+            all[n++] = ht->items[i];
+        }
+    }
+    if (extra != NULL) {
+        all[n++] = extra;
+    }
+    ht_slots_free(ht->items);
+    free(h->hops);
+    ht_moved_all(ht);
+    HT_COUNT(resizes, 1);
+    HT_COUNT(resize_items_moved, n);
+    for (;;) {
+        ht_hopscotch_alloc(ht, h, num_buckets);
+        int i = 0;
+        while (i < n && ht_hopscotch_add(ht, h, all[i])) {
+            i++;
+        }
+        if (i == n) {
+            break;
+        }
+        ht_slots_free(ht->items);
+        free(h->hops);
+        num_buckets = next_prime(num_buckets * 2);
+    }
+    free(all);
+}
+
+//Returns the slot holding key or -1, reading only the slots named by the home bucket's bitmap.
+//Runs under the version check so a displacement racing with it cannot make a present key look absent.
+//The item is handed back through found_item as read inside the check, the slot may have changed again since.
+static int ht_hopscotch_find(const ht_hash_table* ht, const ht_hopscotch* h, const char* key, ht_item** found_item, int* probes) {
+    const int home = ht_hopscotch_home(ht, h, key);
+    __builtin_prefetch(&ht->items[home]);
+    for (;;) {
+        const unsigned int version = __atomic_load_n(&h->version, __ATOMIC_ACQUIRE);
+        if (version & 1) {
+            continue;
+        }
+        int found = -1;
+        *found_item = NULL;
+        *probes = 0;
+        uint32_t hops = __atomic_load_n(&h->hops[home], __ATOMIC_ACQUIRE);
+        while (hops != 0) {
+            const int slot = home + __builtin_ctz(hops);
+            ht_item* item = __atomic_load_n(&ht->items[slot], __ATOMIC_ACQUIRE);
+            (*probes)++;
+            if (item != NULL && strcmp(item->key, key) == 0) {
+                found = slot;
+                *found_item = item;
+                break;
+            }
+            hops &= hops - 1;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&h->version, __ATOMIC_RELAXED) == version) {
+            if (*probes == 0) {
+                *probes = 1; //the bitmap itself was read
+            }
+            return found;
+        }
+    }
+}
+
+void ht_hopscotch_init(ht_hash_table* ht) {
+    ht_hopscotch* h = ht_calloc(1, sizeof(ht_hopscotch));
+    ht->engine = h;
+    ht_slots_free(ht->items);
+    ht_hopscotch_alloc(ht, h, next_prime(ht->base_size));
+}
+
+void ht_hopscotch_free(ht_hash_table* ht) {
+    ht_hopscotch* h = ht->engine;
+    free(h->hops);
+    free(h);
+    ht->engine = NULL;
+}
+
+void ht_hopscotch_insert(ht_hash_table* ht, const char* key, const char* value, const int borrow) {
+    HT_TIMER_START(timer);
+    HT_COUNT(inserts, 1);
+    ht_hopscotch* h = ht->engine;
+    ht_item* found;
+    int probes;
+    const int slot = ht_hopscotch_find(ht, h, key, &found, &probes);
+    HT_COUNT(insert_probes, probes);
+    ht_item* item = ht_new_item(key, value, borrow);
+    if (slot >= 0) {
+        ht_item* old = found;
+        ht->value_bytes -= strlen(old->value) + 1;
+        ht->value_bytes += strlen(item->value) + 1;
+        ht->item_bytes -= ht_item_size(ht, old);
+        ht->item_bytes += ht_item_size(ht, item);
+        __atomic_store_n(&ht->items[slot], item, __ATOMIC_RELEASE);
+        ht_delete_item(old); //a concurrent reader may still hold old or its value, see hopscotch.h
+        HT_TIMER_STOP(timer, insert_cycles);
+        return;
+    }
+    const int added = ht_hopscotch_add(ht, h, item);
+    ht->count++;
+    ht->key_bytes += strlen(item->key) + 1;
+    ht->value_bytes += strlen(item->value) + 1;
+    ht->item_bytes += ht_item_size(ht, item);
+    if (!added) {
+        if (ht->hash_mode == HT_HASH_FAST && ht->count < ht->size / 2) {
+            //no room near home at under half load: the keys collide on purpose, move onto a keyed hash
+            ht->hash_mode = HT_HASH_SIPHASH;
+            ht_random_seed(ht->seed);
+            ht->reseeds++;
+            ht_hopscotch_rebuild(ht, h->num_buckets, item);
+        } else {
+            ht_hopscotch_rebuild(ht, next_prime(h->num_buckets * 2), item);
+        }
+    }
+    HT_TIMER_STOP(timer, insert_cycles);
+}
+
+//the lock free lookup, no statistics are written so any number of threads may call it
+char* ht_hopscotch_read(const ht_hash_table* ht, const char* key) {
+    ht_item* found;
+    int probes;
+    ht_hopscotch_find(ht, ht->engine, key, &found, &probes);
+    return found == NULL ? NULL : found->value;
+}
+
+//the item holding key or NULL, for callers that need the item itself rather than its value
+ht_item* ht_hopscotch_lookup(ht_hash_table* ht, const char* key) {
+    ht_item* found;
+    int probes;
+    ht_hopscotch_find(ht, ht->engine, key, &found, &probes);
+    return found;
+}
+
+char* ht_hopscotch_search(ht_hash_table* ht, const char* key) {
+    HT_TIMER_START(timer);
+    HT_COUNT(searches, 1);
+    ht_item* found;
+    int probes;
+    const int slot = ht_hopscotch_find(ht, ht->engine, key, &found, &probes);
+    HT_COUNT(search_probes, probes);
+    //at most HT_HOP_RANGE slots are read, far below the histogram's open ended last bucket
+    const int bucket = probes <= 1 ? 0 : 32 - __builtin_clz((unsigned int)(probes - 1));
+    if (slot < 0) {
+        ht->miss_probes[bucket]++;
+        HT_TIMER_STOP(timer, search_cycles);
+        return NULL;
+    }
+    ht->hit_probes[bucket]++;
+    HT_TIMER_STOP(timer, search_cycles);
+    return found->value;
+}
+
+int ht_hopscotch_delete(ht_hash_table* ht, const char* key) {
+    HT_TIMER_START(timer);
+    HT_COUNT(deletes, 1);
+    ht_hopscotch* h = ht->engine;
+    ht_item* found;
+    int probes;
+    const int slot = ht_hopscotch_find(ht, h, key, &found, &probes);
+    HT_COUNT(delete_probes, probes);
+    if (slot < 0) {
+        HT_TIMER_STOP(timer, delete_cycles);
+        return 0;
+    }
+    ht_item* item = found;
+    const int home = ht_hopscotch_home(ht, h, key);
+    __atomic_store_n(&h->hops[home], h->hops[home] & ~(1u << (slot - home)), __ATOMIC_RELEASE);
+    __atomic_store_n(&ht->items[slot], NULL, __ATOMIC_RELEASE);
+    ht->key_bytes -= strlen(item->key) + 1;
+    ht->value_bytes -= strlen(item->value) + 1;
+    ht->item_bytes -= ht_item_size(ht, item);
+    ht_delete_item(item);
+    ht->count--;
+    HT_TIMER_STOP(timer, delete_cycles);
+    return 1;
+}
@@ -0,0 +1,41 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#ifndef HOPSCOTCH_H
+#define HOPSCOTCH_H
+
+//Hopscotch layout (HT_LAYOUT_HOPSCOTCH): every key sits within HT_HOP_RANGE slots of its home bucket and the home
+//bucket's hop bitmap records which of those slots hold its keys, so a lookup only reads the slots whose bits are set.
+//
+//Readers may run ht_hopscotch_read concurrently with one writer doing ht_insert of a new key as long as the insert
+//does not grow the table: inserts that displace keys bump a version counter and readers retry when it changed under
+//them. Overwriting an existing key frees the old item and value, deletes free items and growth frees the slot array,
+//so all three still need the readers to be excluded.
+
+#include "hash_table.h"
+
+#define HT_HOP_RANGE 32 //neighbourhood size, one bit per slot in a uint32_t bitmap
+#define HT_HOP_ADD_RANGE 512 //how far past the home bucket an insert looks for a free slot to hop back
+
+void ht_hopscotch_init(ht_hash_table* ht);
+void ht_hopscotch_free(ht_hash_table* ht);
+void ht_hopscotch_insert(ht_hash_table* ht, const char* key, const char* value, const int borrow);
+char* ht_hopscotch_search(ht_hash_table* ht, const char* key);
+ht_item* ht_hopscotch_lookup(ht_hash_table* ht, const char* key);
+char* ht_hopscotch_read(const ht_hash_table* ht, const char* key);
+int ht_hopscotch_delete(ht_hash_table* ht, const char* key);
+
+#endif
@@ -0,0 +1,97 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "instrument.h"
+
+#ifdef HT_INSTRUMENT
+
+#include <pthread.h>
+
+//every thread's counters, linked so a snapshot can find them
+typedef struct ht_counter_block {
+    ht_op_counters counters; //first member, ht_tls_counters points straight at it
+    struct ht_counter_block* next;
+} ht_counter_block;
+
+_Thread_local ht_op_counters* ht_tls_counters = NULL;
+
+static pthread_mutex_t ht_counters_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t ht_counters_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ht_counters_key;
+static ht_counter_block* ht_counter_blocks = NULL;
+static ht_op_counters ht_retired_counters; //totals of threads that have exited
+
+static void ht_counters_add(ht_op_counters* total, const ht_op_counters* c){
+    unsigned long long* dst = (unsigned long long*)total;
+    const unsigned long long* src = (const unsigned long long*)c;
+    for (size_t i = 0; i < sizeof(ht_op_counters) / sizeof(unsigned long long); i++) {
+        dst[i] += __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+//runs at thread exit: folds the thread's counters into the retired totals and unlinks its block
+static void ht_counters_retire(void* arg){
+    ht_counter_block* block = arg;
+    pthread_mutex_lock(&ht_counters_lock);
+    ht_counters_add(&ht_retired_counters, &block->counters);
+    ht_counter_block** link = &ht_counter_blocks;
+    while (*link != block) {
+        link = &(*link)->next;
+    }
+    *link = block->next;
+    pthread_mutex_unlock(&ht_counters_lock);
+    free(block);
+}
+
+static void ht_counters_init(void){
+    pthread_key_create(&ht_counters_key, ht_counters_retire);
+}
+
+//slow path of HT_COUNT, taken once per thread
+ht_op_counters* ht_counters_register(void){
+    pthread_once(&ht_counters_once, ht_counters_init);
+    ht_counter_block* block = calloc(1, sizeof(ht_counter_block));
+    if (block == NULL) {
+        abort();
+    }
+    pthread_mutex_lock(&ht_counters_lock);
+    block->next = ht_counter_blocks;
+    ht_counter_blocks = block;
+    pthread_mutex_unlock(&ht_counters_lock);
+    pthread_setspecific(ht_counters_key, block);
+    ht_tls_counters = &block->counters;
+    return ht_tls_counters;
+}
+
+void ht_instrument_snapshot(ht_op_counters* out){
+    pthread_mutex_lock(&ht_counters_lock);
+    *out = ht_retired_counters;
+    for (ht_counter_block* block = ht_counter_blocks; block != NULL; block = block->next) {
+        ht_counters_add(out, &block->counters);
+    }
+    pthread_mutex_unlock(&ht_counters_lock);
+}
+
+#else
+
+void ht_instrument_snapshot(ht_op_counters* out){
+    memset(out, 0, sizeof(ht_op_counters));
+}
+
+#endif
@@ -0,0 +1,93 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+//Hot path instrumentation for ht_insert, ht_search, ht_delete and ht_resize.
+//Everything compiles to nothing unless the build defines HT_INSTRUMENT (operation, probe and resize counters)
+//or HT_INSTRUMENT_TIMING (the counters plus cycle timing around each operation).
+//Counters live in a per-thread block so the hot path never shares a cache line or takes a lock,
+//ht_instrument_snapshot() sums the blocks of every thread that has touched a table.
+
+#if defined(HT_INSTRUMENT_TIMING) && !defined(HT_INSTRUMENT)
+#define HT_INSTRUMENT
+#endif
+
+typedef struct {
+    unsigned long long inserts;
+    unsigned long long searches;
+    unsigned long long deletes;
+    unsigned long long resizes;
+    unsigned long long insert_probes; //buckets visited, summed over every call
+    unsigned long long search_probes;
+    unsigned long long delete_probes;
+    unsigned long long resize_items_moved;
+    unsigned long long insert_cycles; //only filled in with HT_INSTRUMENT_TIMING
+    unsigned long long search_cycles;
+    unsigned long long delete_cycles;
+    unsigned long long resize_cycles;
+} ht_op_counters;
+
+//sums the counters of every live thread plus those of threads that have already exited
+//always available so callers do not need their own #ifdefs, it reports zeros when instrumentation is compiled out
+void ht_instrument_snapshot(ht_op_counters* out);
+
+#ifdef HT_INSTRUMENT
+
+extern _Thread_local ht_op_counters* ht_tls_counters;
+ht_op_counters* ht_counters_register(void);
+
+//only the owning thread writes its block, the relaxed store keeps snapshot readers race free without a locked add
+#define HT_COUNT(field, n) do { \
+        ht_op_counters* ht_c_ = ht_tls_counters != NULL ? ht_tls_counters : ht_counters_register(); \
+        __atomic_store_n(&ht_c_->field, ht_c_->field + (unsigned long long)(n), __ATOMIC_RELAXED); \
+    } while (0)
+
+#else
+
+#define HT_COUNT(field, n) ((void)0)
+
+#endif
+
+#ifdef HT_INSTRUMENT_TIMING
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline unsigned long long ht_cycles(void) {
+    return __rdtsc();
+}
+#else
+#include <time.h>
+//no cycle counter we can read cheaply from user space, fall back to monotonic nanoseconds
+static inline unsigned long long ht_cycles(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+#endif
+
+#define HT_TIMER_START(t) const unsigned long long t = ht_cycles()
+#define HT_TIMER_STOP(t, field) HT_COUNT(field, ht_cycles() - (t))
+
+#else
+
+#define HT_TIMER_START(t) ((void)0)
+#define HT_TIMER_STOP(t, field) ((void)0)
+
+#endif
+
+#endif
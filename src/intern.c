@@ -0,0 +1,165 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "hash_table_internal.h"
+
+#define HT_INTERN_BORROW (HT_ITEM_BORROWED_KEY | HT_ITEM_BORROWED_VALUE)
+
+//Arena chunk. Each string is copied in after its 4 byte id, so ht_intern_id finds the id without a lookup.
+struct ht_intern_chunk {
+    struct ht_intern_chunk* next;
+    char data[];
+};
+
+struct ht_intern_retired {
+    ht_hash_table* table;
+    struct ht_intern_retired* next;
+};
+
+ht_interner* ht_intern_new(void) {
+    ht_interner* interner = ht_calloc(1, sizeof(ht_interner));
+    interner->table = ht_new_seeded();
+    pthread_mutex_init(&interner->lock, NULL);
+    return interner;
+}
+
+void ht_intern_free(ht_interner* interner) {
+    //the tables only borrow the arena's strings, deleting them frees the items and slot arrays
+    ht_delete_hash_table(interner->table);
+    while (interner->retired != NULL) {
+        struct ht_intern_retired* r = interner->retired;
+        interner->retired = r->next;
+        ht_delete_hash_table(r->table);
+        free(r);
+    }
+    for (int p = 0; p < HT_INTERN_PAGES; p++) {
+        free(interner->pages[p]);
+    }
+    while (interner->chunks != NULL) {
+        struct ht_intern_chunk* c = interner->chunks;
+        interner->chunks = c->next;
+        free(c);
+    }
+    pthread_mutex_destroy(&interner->lock);
+    free(interner);
+}
+
+//copies s into the arena behind its id and returns the copy
+static char* ht_intern_copy(ht_interner* interner, const char* s, const uint32_t id) {
+    const size_t len = strlen(s) + 1;
+    const size_t need = (sizeof(uint32_t) + len + 3) & ~(size_t)3; //keeps every id 4 byte aligned
+    if (need > interner->left) {
+        const size_t size = need > HT_INTERN_CHUNK ? need : HT_INTERN_CHUNK;
+        struct ht_intern_chunk* c = ht_malloc(sizeof(struct ht_intern_chunk) + size);
+        c->next = interner->chunks;
+        interner->chunks = c;
+        interner->next = c->data;
+        interner->left = size;
+    }
+    char* record = interner->next;
+    memcpy(record, &id, sizeof(uint32_t));
+    memcpy(record + sizeof(uint32_t), s, len);
+    interner->next += need;
+    interner->left -= need;
+    return record + sizeof(uint32_t);
+}
+
+//Moves every string into a table with room for a few times as many and publishes it. Lookups may still be probing
+//the old table, and with nothing to tell when they are done it is retired rather than freed: the retired tables
+//add up to less than the live one.
+static void ht_intern_grow(ht_interner* interner) {
+    ht_hash_table* old = interner->table;
+    ht_hash_table* bigger = ht_new_seeded();
+    const long long reserve = (long long)old->size * 2; //old->size * 2 alone overflows int past a billion slots
+    ht_reserve(bigger, reserve > HT_MAX_BASE_SIZE ? HT_MAX_BASE_SIZE : (int)reserve);
+    ht_iter it;
+    const char* key;
+    const char* value;
+    ht_iter_begin(old, &it);
+    while (ht_iter_next(&it, &key, &value)) {
+        ht_insert_borrowed(bigger, key, value, HT_INTERN_BORROW);
+    }
+    struct ht_intern_retired* r = ht_malloc(sizeof(struct ht_intern_retired));
+    r->table = old;
+    r->next = interner->retired;
+    interner->retired = r;
+    __atomic_store_n(&interner->table, bigger, __ATOMIC_RELEASE);
+}
+
+//Returns the interned copy of s, adding it first if this is the first time s is seen. The copy keeps its address
+//until ht_intern_free. Returns NULL only once all 2^32 ids have been handed out.
+const char* ht_intern(ht_interner* interner, const char* s) {
+    const char* interned = ht_intern_lookup(interner, s);
+    if (interned != NULL) {
+        return interned;
+    }
+    pthread_mutex_lock(&interner->lock);
+    interned = ht_intern_lookup(interner, s); //another thread may have added it while we waited
+    if (interned == NULL && interner->count < UINT32_MAX) {
+        //Keeping the live table at most half full means ht_insert never resizes it under a lookup, and with a
+        //random SipHash seed a probe long enough to trigger a reseed is out of the question. A table already at the
+        //largest size is kept, rebuilding it would not make it any bigger.
+        if ((long long)(interner->table->count + 1) * 2 > interner->table->size &&
+            interner->table->size < HT_MAX_BASE_SIZE) {
+            ht_intern_grow(interner);
+        }
+        const uint32_t id = interner->count;
+        char* copy = ht_intern_copy(interner, s, id);
+        const char** page = interner->pages[id >> HT_INTERN_PAGE_BITS];
+        if (page == NULL) {
+            page = ht_calloc((size_t)1 << HT_INTERN_PAGE_BITS, sizeof(const char*));
+            __atomic_store_n(&interner->pages[id >> HT_INTERN_PAGE_BITS], page, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&page[id & ((1u << HT_INTERN_PAGE_BITS) - 1)], copy, __ATOMIC_RELEASE);
+        __atomic_store_n(&interner->count, id + 1, __ATOMIC_RELEASE);
+        ht_insert_borrowed(interner->table, copy, copy, HT_INTERN_BORROW);
+        interned = copy;
+    }
+    pthread_mutex_unlock(&interner->lock);
+    return interned;
+}
+
+//the interned copy of s or NULL if s has not been interned, never locks
+const char* ht_intern_lookup(const ht_interner* interner, const char* s) {
+    const ht_hash_table* table = __atomic_load_n(&interner->table, __ATOMIC_ACQUIRE);
+    const ht_item* item = ht_search_shared(table, s);
+    return item != NULL ? item->key : NULL;
+}
+
+//the id of a string returned by ht_intern or ht_intern_lookup, ids count up from 0 in the order strings were added
+uint32_t ht_intern_id(const char* interned) {
+    uint32_t id;
+    memcpy(&id, interned - sizeof(uint32_t), sizeof(uint32_t));
+    return id;
+}
+
+//the interned string with the given id, NULL for an id not handed out yet
+const char* ht_intern_string(const ht_interner* interner, const uint32_t id) {
+    if (id >= __atomic_load_n(&interner->count, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    const char** page = __atomic_load_n(&interner->pages[id >> HT_INTERN_PAGE_BITS], __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&page[id & ((1u << HT_INTERN_PAGE_BITS) - 1)], __ATOMIC_ACQUIRE);
+}
+
+uint32_t ht_intern_count(const ht_interner* interner) {
+    return __atomic_load_n(&interner->count, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,60 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#ifndef INTERN_H
+#define INTERN_H
+
+//String interning on top of ht_hash_table: every distinct string is stored once and gets a stable pointer plus a
+//dense 32 bit id, so downstream code compares strings by pointer or id and memory holds one copy per string.
+//
+//ht_intern_lookup, ht_intern_id and ht_intern_string never lock and may run on any number of threads alongside
+//ht_intern. ht_intern serializes the threads that add new strings on a mutex, its fast path for strings that are
+//already interned is ht_intern_lookup. Interned strings live until ht_intern_free.
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash_table.h"
+
+#define HT_INTERN_CHUNK 65536 //bytes per arena chunk, longer strings get a chunk of their own
+#define HT_INTERN_PAGE_BITS 16 //ids per page of the id to string map is 1 << HT_INTERN_PAGE_BITS
+#define HT_INTERN_PAGES 65536 //pages in the id to string map, enough for every 32 bit id
+
+struct ht_intern_chunk;
+struct ht_intern_retired;
+
+typedef struct {
+    ht_hash_table* table; //the live table, key and value of every item are the arena copy; swapped whole to grow
+    struct ht_intern_retired* retired; //earlier tables, kept until ht_intern_free for lookups that may still read them
+    const char** pages[HT_INTERN_PAGES]; //id to string map, a page is allocated when its first id is handed out
+    uint32_t count; //ids handed out so far, published after the string it makes visible
+    struct ht_intern_chunk* chunks; //arena, strings never move once copied in
+    char* next; //free space in the newest chunk
+    size_t left;
+    pthread_mutex_t lock; //held by ht_intern while it adds a string
+} ht_interner;
+
+ht_interner* ht_intern_new(void);
+void ht_intern_free(ht_interner* interner);
+const char* ht_intern(ht_interner* interner, const char* s);
+const char* ht_intern_lookup(const ht_interner* interner, const char* s);
+uint32_t ht_intern_id(const char* interned);
+const char* ht_intern_string(const ht_interner* interner, const uint32_t id);
+uint32_t ht_intern_count(const ht_interner* interner);
+
+#endif
@@ -0,0 +1,167 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+//Load generator for the key-value server: each thread opens its own connection and keeps a pipeline of requests
+//in flight, a mix of GETs and SETs over a fixed key space, and the total rate is reported at the end. Run it against
+//./ht_server and ./ht_server --uring to compare the two event loops, the server prints its system call count on exit.
+//Build: gcc -O2 -pthread -o loadgen loadgen.c server.c hash_table.c prime.c siphash.c instrument.c cuckoo.c
+//       hopscotch.c timer_wheel.c thread_pool.c slots.c placement.c sketch.c -lm
+//Usage: ./loadgen [socket path] [threads] [pipeline depth] [seconds] [keys] [percent SETs]
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+
+#define LOADGEN_DEFAULT_SOCKET "/tmp/ht_server.sock"
+
+typedef struct {
+    const char* path;
+    int depth;
+    int keys;
+    int set_percent;
+    double seconds;
+    unsigned seed;
+    unsigned long long ops;
+    unsigned long long errors;
+} loadgen_worker;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int connect_unix(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror(path);
+        exit(1);
+    }
+    return fd;
+}
+
+static void write_all(const int fd, const char* data, size_t len) {
+    while (len > 0) {
+        const ssize_t n = write(fd, data, len);
+        if (n <= 0) {
+            perror("write");
+            exit(1);
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+}
+
+//reads until count whole responses are in, counting the ones that are not OK or NOT_FOUND
+static unsigned long long read_responses(const int fd, ht_buf* in, int count) {
+    unsigned long long errors = 0;
+    size_t off = 0;
+    while (count > 0) {
+        if (in->len - off >= sizeof(ht_response_header)) {
+            ht_response_header header;
+            memcpy(&header, in->data + off, sizeof(header));
+            if (in->len - off >= sizeof(header) + header.value_len) {
+                errors += header.status == HT_STATUS_ERROR;
+                off += sizeof(header) + header.value_len;
+                count--;
+                continue;
+            }
+        }
+        ht_buf_reserve(in, 65536);
+        const ssize_t n = read(fd, in->data + in->len, in->cap - in->len);
+        if (n <= 0) {
+            perror("read");
+            exit(1);
+        }
+        in->len += (size_t)n;
+    }
+    ht_buf_consume(in, off);
+    return errors;
+}
+
+static void* loadgen_run(void* arg) {
+    loadgen_worker* w = arg;
+    const int fd = connect_unix(w->path);
+    ht_buf out = {NULL, 0, 0};
+    ht_buf in = {NULL, 0, 0};
+    char key[32];
+    const char* value = "loadgen-value-0123456789";
+    const double end = now_seconds() + w->seconds;
+    while (now_seconds() < end) {
+        for (int i = 0; i < w->depth; i++) {
+            const int k = (int)(rand_r(&w->seed) % (unsigned)w->keys);
+            const int is_set = (int)(rand_r(&w->seed) % 100) < w->set_percent;
+            const int key_len = snprintf(key, sizeof(key), "key:%d", k);
+            ht_request_header header = {is_set ? HT_OP_SET : HT_OP_GET, 0, (uint16_t)key_len,
+                                        is_set ? (uint32_t)strlen(value) : 0};
+            ht_buf_append(&out, &header, sizeof(header));
+            ht_buf_append(&out, key, (size_t)key_len);
+            if (is_set) {
+                ht_buf_append(&out, value, strlen(value));
+            }
+        }
+        write_all(fd, out.data, out.len);
+        out.len = 0;
+        w->errors += read_responses(fd, &in, w->depth);
+        w->ops += (unsigned long long)w->depth;
+    }
+    close(fd);
+    ht_buf_free(&out);
+    ht_buf_free(&in);
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : LOADGEN_DEFAULT_SOCKET;
+    const int threads = argc > 2 ? atoi(argv[2]) : 4;
+    const int depth = argc > 3 ? atoi(argv[3]) : 64;
+    const double seconds = argc > 4 ? atof(argv[4]) : 5;
+    const int keys = argc > 5 ? atoi(argv[5]) : 100000;
+    const int set_percent = argc > 6 ? atoi(argv[6]) : 10;
+
+    loadgen_worker* workers = calloc((size_t)threads, sizeof(loadgen_worker));
+    pthread_t* tids = malloc(sizeof(pthread_t) * (size_t)threads);
+    const double start = now_seconds();
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (loadgen_worker){path, depth, keys, set_percent, seconds, (unsigned)i * 7919u + 1, 0, 0};
+        pthread_create(&tids[i], NULL, loadgen_run, &workers[i]);
+    }
+    unsigned long long ops = 0;
+    unsigned long long errors = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        ops += workers[i].ops;
+        errors += workers[i].errors;
+    }
+    const double elapsed = now_seconds() - start;
+    printf("%d connections x %d deep: %llu ops in %.2fs, %.0f ops/s, %llu errors\n", threads, depth, ops, elapsed,
+           ops / elapsed, errors);
+    free(workers);
+    free(tids);
+    return 0;
+}
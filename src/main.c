@@ -14,9 +14,123 @@
 //Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
 //Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
 
+//Standalone key-value server: owns one ht_hash_table and serves it over a Unix domain socket with the pipelined
+//binary protocol described in server.h, so many processes share one copy of the data. Runs until SIGINT or SIGTERM.
+//Build: gcc -O2 -pthread -o ht_server main.c server.c server_uring.c memcache.c shard.c hash_table.c prime.c
+//       siphash.c instrument.c cuckoo.c hopscotch.c timer_wheel.c thread_pool.c slots.c placement.c sketch.c -lm
+//Usage: ./ht_server [--uring] [--memcache port] [--cores n] [socket path]
+//--uring serves through io_uring instead of epoll, the system calls each made are printed on exit for comparison.
+//--memcache also serves the memcached protocol (see memcache.h) on 127.0.0.1:port, for memcached clients and tools.
+//--cores runs the thread-per-core server of shard.h instead, n shards on n pinned threads (0 for one per CPU),
+//serving the binary protocol only.
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "hash_table.h"
+#include "memcache.h"
+#include "server.h"
+#include "shard.h"
+
+#define HT_DEFAULT_SOCKET "/tmp/ht_server.sock"
+
+static ht_server* running_server;
+static ht_shard_server* running_shards;
+
+static void on_signal(int sig) {
+    (void)sig;
+    const int saved = errno;
+    if (running_shards != NULL) {
+        ht_shard_server_stop(running_shards);
+    } else {
+        ht_server_stop(running_server);
+    }
+    errno = saved;
+}
+
+static void on_stop_signals(void) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+}
+
+static int run_shards(const int cores, const char* path) {
+    running_shards = ht_shard_server_new(cores);
+    if (running_shards == NULL) {
+        perror("ht_shard_server_new");
+        return 1;
+    }
+    if (ht_shard_server_listen_unix(running_shards, path) < 0) {
+        perror(path);
+        return 1;
+    }
+    on_stop_signals();
+    printf("serving on %s with %d cores\n", path, ht_shard_server_cores(running_shards));
+    fflush(stdout);
+    const int result = ht_shard_server_run(running_shards);
+    if (result < 0) {
+        perror("ht_shard_server_run");
+    }
+    ht_shard_server_free(running_shards);
+    return result < 0 ? 1 : 0;
+}
 
-int main() {
-    ht_hash_table* ht = ht_new();
-    ht_del_hash_table(ht);
-}
\ No newline at end of file
+int main(int argc, char** argv) {
+    int uring = 0;
+    int memcache_port = 0;
+    int cores = -1;
+    const char* path = HT_DEFAULT_SOCKET;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--uring") == 0) {
+            uring = 1;
+        } else if (strcmp(argv[i], "--memcache") == 0 && i + 1 < argc) {
+            memcache_port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--cores") == 0 && i + 1 < argc) {
+            cores = atoi(argv[++i]);
+        } else {
+            path = argv[i];
+        }
+    }
+    if (cores >= 0) {
+        if (uring || memcache_port != 0) {
+            fprintf(stderr, "--cores serves the binary protocol with epoll only, drop --uring and --memcache\n");
+            return 1;
+        }
+        return run_shards(cores, path);
+    }
+    //clients are other processes, so keys are hashed under a random seed that they cannot flood
+    ht_hash_table* ht = ht_new_seeded();
+    running_server = ht_server_new(ht);
+    if (running_server == NULL) {
+        perror("ht_server_new");
+        return 1;
+    }
+    if (ht_server_listen_unix(running_server, path, ht_binary_process) < 0) {
+        perror(path);
+        return 1;
+    }
+    if (memcache_port != 0 && ht_server_listen_tcp(running_server, "127.0.0.1", memcache_port, ht_memcache_process) < 0) {
+        perror("memcache listener");
+        return 1;
+    }
+    on_stop_signals();
+    printf("serving on %s with %s\n", path, uring ? "io_uring" : "epoll");
+    if (memcache_port != 0) {
+        printf("memcached protocol on 127.0.0.1:%d\n", memcache_port);
+    }
+    fflush(stdout);
+    const int result = uring ? ht_server_run_uring(running_server) : ht_server_run(running_server);
+    if (result < 0) {
+        perror(uring ? "ht_server_run_uring" : "ht_server_run");
+    }
+    printf("%llu system calls\n", ht_server_syscalls(running_server));
+    ht_server_free(running_server);
+    ht_delete_hash_table(ht);
+    return result < 0 ? 1 : 0;
+}
@@ -0,0 +1,433 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash_table_internal.h"
+#include "memcache.h"
+
+#define HT_MC_REQUEST 0x80 //magic byte opening a binary request
+#define HT_MC_RESPONSE 0x81
+#define HT_MC_HEADER 24 //bytes in a binary request or response header
+#define HT_MC_RELATIVE_MAX 2592000 //exptimes up to 30 days are relative, larger ones are Unix times
+
+#define HT_MC_GET 0x00
+#define HT_MC_SET 0x01
+#define HT_MC_DELETE 0x04
+#define HT_MC_QUIT 0x07
+#define HT_MC_GETQ 0x09
+#define HT_MC_NOOP 0x0a
+#define HT_MC_VERSION 0x0b
+#define HT_MC_GETK 0x0c
+#define HT_MC_GETKQ 0x0d
+#define HT_MC_SETQ 0x11
+#define HT_MC_DELETEQ 0x14
+#define HT_MC_QUITQ 0x17
+
+#define HT_MC_OK 0x0000
+#define HT_MC_NOT_FOUND 0x0001
+#define HT_MC_INVALID 0x0004
+#define HT_MC_UNKNOWN 0x0081
+
+#define HT_MC_VERSION_STRING "1.6.0"
+
+static uint16_t ht_mc_get16(const char* p) {
+    return (uint16_t)((uint8_t)p[0] << 8 | (uint8_t)p[1]);
+}
+
+static uint32_t ht_mc_get32(const char* p) {
+    return (uint32_t)(uint8_t)p[0] << 24 | (uint32_t)(uint8_t)p[1] << 16 | (uint32_t)(uint8_t)p[2] << 8 | (uint8_t)p[3];
+}
+
+static void ht_mc_put16(char* p, const uint16_t v) {
+    p[0] = (char)(v >> 8);
+    p[1] = (char)v;
+}
+
+static void ht_mc_put32(char* p, const uint32_t v) {
+    p[0] = (char)(v >> 24);
+    p[1] = (char)(v >> 16);
+    p[2] = (char)(v >> 8);
+    p[3] = (char)v;
+}
+
+//ht_upsert callback of set, hands the table the copy already made of the value
+static char* ht_mc_take(const char* key, char* current, void* ctx) {
+    (void)key;
+    (void)current;
+    return ctx;
+}
+
+//Stores bytes of data under key with memcached's reading of exptime: 0 never expires, up to 30 days is seconds from
+//now, anything larger a Unix time, and a time already past deletes the key.
+static void ht_mc_store(ht_hash_table* ht, const char* key, const char* data, const size_t bytes, long exptime) {
+    if (exptime > HT_MC_RELATIVE_MAX) {
+        exptime -= (long)time(NULL);
+        if (exptime <= 0) {
+            exptime = -1;
+        }
+    }
+    if (exptime < 0) {
+        ht_delete(ht, key);
+        return;
+    }
+    char* value = ht_malloc(bytes + 1);
+    memcpy(value, data, bytes);
+    value[bytes] = '\0';
+    if (exptime > 0) {
+        ht_insert_ttl(ht, key, value, (int)exptime);
+        free(value);
+        return;
+    }
+    if (ht->wheel != NULL) {
+        ht_delete(ht, key); //the expiry of an earlier set must not carry over to this one
+    }
+    ht_upsert(ht, key, ht_mc_take, value);
+}
+
+//next space separated token of the line at *cursor, NUL terminated in place, or NULL at the end of the line
+static char* ht_mc_token(char** cursor) {
+    char* p = *cursor;
+    while (*p == ' ') {
+        p++;
+    }
+    if (*p == '\0') {
+        *cursor = p;
+        return NULL;
+    }
+    char* token = p;
+    while (*p != ' ' && *p != '\0') {
+        p++;
+    }
+    if (*p == ' ') {
+        *p++ = '\0';
+    }
+    *cursor = p;
+    return token;
+}
+
+//a whole decimal number, no sign unless negative is set
+static int ht_mc_number(const char* token, const int negative, long long* out) {
+    if (token == NULL || (*token == '-' && !negative)) {
+        return 0;
+    }
+    char* end;
+    *out = strtoll(token, &end, 10);
+    return end != token && *end == '\0';
+}
+
+static void ht_mc_text_values(ht_hash_table* ht, const char* const* keys, const int n, const int cas, ht_buf* out) {
+    char* values[HT_MEMCACHE_BATCH];
+    ht_search_batch(ht, keys, n, values);
+    for (int i = 0; i < n; i++) {
+        if (values[i] == NULL) {
+            continue;
+        }
+        const size_t key_len = strlen(keys[i]);
+        const size_t value_len = strlen(values[i]);
+        char line[64];
+        ht_buf_reserve(out, key_len + value_len + sizeof(line) + 8);
+        ht_buf_append(out, "VALUE ", 6);
+        ht_buf_append(out, keys[i], key_len);
+        ht_buf_append(out, line, (size_t)snprintf(line, sizeof(line), " 0 %zu%s\r\n", value_len, cas ? " 0" : ""));
+        ht_buf_append(out, values[i], value_len);
+        ht_buf_append(out, "\r\n", 2);
+    }
+}
+
+//get and gets: every key named is looked up, HT_MEMCACHE_BATCH at a time
+static void ht_mc_text_get(ht_hash_table* ht, char* cursor, const int cas, ht_buf* out) {
+    const char* keys[HT_MEMCACHE_BATCH];
+    int n = 0;
+    char* key;
+    while ((key = ht_mc_token(&cursor)) != NULL) {
+        if (strlen(key) > HT_MEMCACHE_MAX_KEY) {
+            ht_mc_text_values(ht, keys, n, cas, out);
+            ht_buf_append(out, "CLIENT_ERROR bad command line format\r\n", 38);
+            return;
+        }
+        keys[n++] = key;
+        if (n == HT_MEMCACHE_BATCH) {
+            ht_mc_text_values(ht, keys, n, cas, out);
+            n = 0;
+        }
+    }
+    ht_mc_text_values(ht, keys, n, cas, out);
+    ht_buf_append(out, "END\r\n", 5);
+}
+
+//one text command at the start of in: bytes consumed, 0 if it has not all arrived, -1 to drop the connection
+static long ht_mc_text(ht_hash_table* ht, const char* in, const size_t len, ht_buf* out) {
+    const size_t scan = len < HT_MEMCACHE_MAX_LINE ? len : HT_MEMCACHE_MAX_LINE;
+    const char* newline = memchr(in, '\n', scan);
+    if (newline == NULL) {
+        return len < HT_MEMCACHE_MAX_LINE ? 0 : -1;
+    }
+    size_t line_len = (size_t)(newline - in);
+    const size_t used = line_len + 1;
+    if (line_len > 0 && in[line_len - 1] == '\r') {
+        line_len--;
+    }
+    char line[HT_MEMCACHE_MAX_LINE];
+    memcpy(line, in, line_len);
+    line[line_len] = '\0';
+    if (memchr(line, '\0', line_len) != NULL) {
+        ht_buf_append(out, "ERROR\r\n", 7);
+        return (long)used;
+    }
+    char* cursor = line;
+    const char* command = ht_mc_token(&cursor);
+    if (command == NULL) {
+        ht_buf_append(out, "ERROR\r\n", 7);
+        return (long)used;
+    }
+    if (strcmp(command, "get") == 0 || strcmp(command, "gets") == 0) {
+        ht_mc_text_get(ht, cursor, command[3] == 's', out);
+        return (long)used;
+    }
+    if (strcmp(command, "set") == 0) {
+        const char* key = ht_mc_token(&cursor);
+        long long flags;
+        long long exptime;
+        long long bytes;
+        const int valid = key != NULL && ht_mc_number(ht_mc_token(&cursor), 0, &flags) &&
+                          ht_mc_number(ht_mc_token(&cursor), 1, &exptime) &&
+                          ht_mc_number(ht_mc_token(&cursor), 0, &bytes);
+        const char* option = valid ? ht_mc_token(&cursor) : NULL;
+        const int noreply = option != NULL && strcmp(option, "noreply") == 0;
+        if (!valid || (option != NULL && !noreply) || flags > UINT32_MAX) {
+            ht_buf_append(out, "CLIENT_ERROR bad command line format\r\n", 38);
+            return (long)used;
+        }
+        if (bytes > HT_SERVER_MAX_VALUE) {
+            return -1; //too much to wait for only to throw away
+        }
+        const size_t total = used + (size_t)bytes + 2;
+        if (len < total) {
+            return 0;
+        }
+        const char* data = in + used;
+        if (data[bytes] != '\r' || data[bytes + 1] != '\n') {
+            return -1; //the data block is not where the command said, the stream is lost
+        }
+        if (strlen(key) > HT_MEMCACHE_MAX_KEY) {
+            ht_buf_append(out, "CLIENT_ERROR bad command line format\r\n", 38);
+        } else if (memchr(data, '\0', (size_t)bytes) != NULL) {
+            ht_buf_append(out, "SERVER_ERROR binary values not supported\r\n", 42);
+        } else {
+            ht_mc_store(ht, key, data, (size_t)bytes, (long)exptime);
+            if (!noreply) {
+                ht_buf_append(out, "STORED\r\n", 8);
+            }
+        }
+        return (long)total;
+    }
+    if (strcmp(command, "delete") == 0) {
+        const char* key = ht_mc_token(&cursor);
+        const char* option = ht_mc_token(&cursor);
+        if (option != NULL && strcmp(option, "0") == 0) {
+            option = ht_mc_token(&cursor); //a zero hold time is still accepted from old clients
+        }
+        const int noreply = option != NULL && strcmp(option, "noreply") == 0;
+        if (key == NULL || strlen(key) > HT_MEMCACHE_MAX_KEY || (option != NULL && !noreply)) {
+            ht_buf_append(out, "CLIENT_ERROR bad command line format\r\n", 38);
+            return (long)used;
+        }
+        const int deleted = ht_delete(ht, key);
+        if (!noreply) {
+            ht_buf_append(out, deleted ? "DELETED\r\n" : "NOT_FOUND\r\n", deleted ? 9 : 11);
+        }
+        return (long)used;
+    }
+    if (strcmp(command, "version") == 0) {
+        ht_buf_append(out, "VERSION " HT_MC_VERSION_STRING "\r\n", 15);
+        return (long)used;
+    }
+    if (strcmp(command, "quit") == 0) {
+        return -1;
+    }
+    ht_buf_append(out, "ERROR\r\n", 7);
+    return (long)used;
+}
+
+//a binary response to request, which supplies the opcode and the opaque value echoed back
+static void ht_mc_respond(ht_buf* out, const char* request, const uint16_t status, const char* extras,
+                          const uint8_t extras_len, const char* key, const uint16_t key_len, const char* value,
+                          const uint32_t value_len) {
+    const uint32_t body = extras_len + key_len + value_len;
+    ht_buf_reserve(out, HT_MC_HEADER + body);
+    char* header = out->data + out->len;
+    memset(header, 0, HT_MC_HEADER);
+    header[0] = (char)HT_MC_RESPONSE;
+    header[1] = request[1];
+    ht_mc_put16(header + 2, key_len);
+    header[4] = (char)extras_len;
+    ht_mc_put16(header + 6, status);
+    ht_mc_put32(header + 8, body);
+    memcpy(header + 12, request + 12, 4);
+    out->len += HT_MC_HEADER;
+    ht_buf_append(out, extras, extras_len);
+    ht_buf_append(out, key, key_len);
+    ht_buf_append(out, value, value_len);
+}
+
+static void ht_mc_error(ht_buf* out, const char* request, const uint16_t status) {
+    const char* message = status == HT_MC_NOT_FOUND ? "Not found" :
+                          status == HT_MC_INVALID ? "Invalid arguments" : "Unknown command";
+    ht_mc_respond(out, request, status, NULL, 0, NULL, 0, message, (uint32_t)strlen(message));
+}
+
+static int ht_mc_is_get(const uint8_t opcode) {
+    return opcode == HT_MC_GET || opcode == HT_MC_GETQ || opcode == HT_MC_GETK || opcode == HT_MC_GETKQ;
+}
+
+//bytes in the complete binary request at the start of in, 0 if it has not all arrived, -1 if it is malformed
+static long ht_mc_binary_size(const char* in, const size_t len) {
+    if (len < HT_MC_HEADER) {
+        return 0;
+    }
+    const uint32_t body = ht_mc_get32(in + 8);
+    if (body > HT_SERVER_MAX_VALUE + HT_MEMCACHE_MAX_KEY + 255 || (uint32_t)(uint8_t)in[4] + ht_mc_get16(in + 2) > body) {
+        return -1;
+    }
+    return len < HT_MC_HEADER + (size_t)body ? 0 : HT_MC_HEADER + (long)body;
+}
+
+//copies the key of a binary request out NUL terminated, 0 if it is not one the table can store
+static int ht_mc_binary_key(const char* request, char* key) {
+    const uint16_t key_len = ht_mc_get16(request + 2);
+    const char* k = request + HT_MC_HEADER + (uint8_t)request[4];
+    if (key_len == 0 || key_len > HT_MEMCACHE_MAX_KEY || memchr(k, '\0', key_len) != NULL) {
+        return 0;
+    }
+    memcpy(key, k, key_len);
+    key[key_len] = '\0';
+    return 1;
+}
+
+//A run of pipelined binary GETs from the start of in, up to HT_MEMCACHE_BATCH of them, looked up together.
+//Returns the bytes consumed, at least the first request which the caller has checked is complete.
+static long ht_mc_binary_gets(ht_hash_table* ht, const char* in, const size_t len, ht_buf* out) {
+    char keys[HT_MEMCACHE_BATCH][HT_MEMCACHE_MAX_KEY + 1];
+    const char* lookups[HT_MEMCACHE_BATCH];
+    const char* requests[HT_MEMCACHE_BATCH];
+    int valid[HT_MEMCACHE_BATCH];
+    char* values[HT_MEMCACHE_BATCH];
+    int n = 0;
+    int found = 0;
+    size_t off = 0;
+    while (n < HT_MEMCACHE_BATCH && len - off >= 2 && (uint8_t)in[off] == HT_MC_REQUEST &&
+           ht_mc_is_get((uint8_t)in[off + 1])) {
+        const long size = ht_mc_binary_size(in + off, len - off);
+        if (size <= 0) {
+            break; //left for the caller to wait on or reject
+        }
+        requests[n] = in + off;
+        valid[n] = ht_mc_binary_key(in + off, keys[n]);
+        if (valid[n]) {
+            lookups[found++] = keys[n];
+        }
+        n++;
+        off += (size_t)size;
+    }
+    if (found > 0) {
+        ht_search_batch(ht, lookups, found, values);
+    }
+    found = 0;
+    for (int i = 0; i < n; i++) {
+        const uint8_t opcode = (uint8_t)requests[i][1];
+        const int quiet = opcode == HT_MC_GETQ || opcode == HT_MC_GETKQ;
+        if (!valid[i]) {
+            ht_mc_error(out, requests[i], HT_MC_INVALID);
+            continue;
+        }
+        const char* value = values[found++];
+        const uint16_t key_len = (opcode == HT_MC_GETK || opcode == HT_MC_GETKQ) ? ht_mc_get16(requests[i] + 2) : 0;
+        if (value != NULL) {
+            const char flags[4] = {0, 0, 0, 0};
+            ht_mc_respond(out, requests[i], HT_MC_OK, flags, 4, keys[i], key_len, value, (uint32_t)strlen(value));
+        } else if (!quiet) {
+            ht_mc_respond(out, requests[i], HT_MC_NOT_FOUND, NULL, 0, keys[i], key_len, "Not found", 9);
+        }
+    }
+    return (long)off;
+}
+
+//one binary request at the start of in: bytes consumed, 0 if it has not all arrived, -1 to drop the connection
+static long ht_mc_binary(ht_hash_table* ht, const char* in, const size_t len, ht_buf* out) {
+    const long size = ht_mc_binary_size(in, len);
+    if (size <= 0) {
+        return size;
+    }
+    const uint8_t opcode = (uint8_t)in[1];
+    if (ht_mc_is_get(opcode)) {
+        return ht_mc_binary_gets(ht, in, len, out);
+    }
+    const uint8_t extras_len = (uint8_t)in[4];
+    const char* extras = in + HT_MC_HEADER;
+    char key[HT_MEMCACHE_MAX_KEY + 1];
+    if (opcode == HT_MC_SET || opcode == HT_MC_SETQ) {
+        const uint16_t key_len = ht_mc_get16(in + 2);
+        const char* value = extras + extras_len + key_len;
+        const size_t value_len = (size_t)size - HT_MC_HEADER - extras_len - key_len;
+        if (extras_len != 8 || !ht_mc_binary_key(in, key) || memchr(value, '\0', value_len) != NULL) {
+            ht_mc_error(out, in, HT_MC_INVALID);
+        } else {
+            ht_mc_store(ht, key, value, value_len, (long)ht_mc_get32(extras + 4));
+            if (opcode == HT_MC_SET) {
+                ht_mc_respond(out, in, HT_MC_OK, NULL, 0, NULL, 0, NULL, 0);
+            }
+        }
+    } else if (opcode == HT_MC_DELETE || opcode == HT_MC_DELETEQ) {
+        if (extras_len != 0 || !ht_mc_binary_key(in, key)) {
+            ht_mc_error(out, in, HT_MC_INVALID);
+        } else if (!ht_delete(ht, key)) {
+            ht_mc_error(out, in, HT_MC_NOT_FOUND);
+        } else if (opcode == HT_MC_DELETE) {
+            ht_mc_respond(out, in, HT_MC_OK, NULL, 0, NULL, 0, NULL, 0);
+        }
+    } else if (opcode == HT_MC_NOOP) {
+        ht_mc_respond(out, in, HT_MC_OK, NULL, 0, NULL, 0, NULL, 0);
+    } else if (opcode == HT_MC_VERSION) {
+        ht_mc_respond(out, in, HT_MC_OK, NULL, 0, NULL, 0, HT_MC_VERSION_STRING, 5);
+    } else if (opcode == HT_MC_QUIT || opcode == HT_MC_QUITQ) {
+        return -1;
+    } else {
+        ht_mc_error(out, in, HT_MC_UNKNOWN);
+    }
+    return size;
+}
+
+long ht_memcache_process(ht_hash_table* ht, const char* in, const size_t len, ht_buf* out) {
+    size_t off = 0;
+    while (off < len) {
+        const long used = (uint8_t)in[off] == HT_MC_REQUEST ? ht_mc_binary(ht, in + off, len - off, out)
+                                                            : ht_mc_text(ht, in + off, len - off, out);
+        if (used < 0) {
+            return -1;
+        }
+        if (used == 0) {
+            break;
+        }
+        off += (size_t)used;
+    }
+    return (long)off;
+}
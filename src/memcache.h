@@ -0,0 +1,44 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#ifndef MEMCACHE_H
+#define MEMCACHE_H
+
+//The memcached protocol, text and binary, as an ht_protocol_fn for ht_server, so memcached clients and load tools can
+//be pointed at the table. Each request is told apart by its first byte, 0x80 starting a binary one.
+//
+//Text:   get/gets <key>*, set <key> <flags> <exptime> <bytes> [noreply], delete <key> [noreply], version, quit
+//Binary: GET, GETQ, GETK, GETKQ, SET, SETQ, DELETE, DELETEQ, NOOP, VERSION, QUIT
+//
+//A multiget, one get line naming several keys or a run of pipelined binary GETs, is looked up with
+//ht_search_batch. The table keeps C strings only: client flags are not stored and come back as 0, gets reports a CAS
+//of 0, and a value holding a NUL byte is refused. A nonzero exptime stores the key with ht_insert_ttl, counted in
+//seconds from now or, past 30 days, as a Unix time as memcached does. Only HT_LAYOUT_OPEN tables keep the expiry,
+//on cuckoo and hopscotch tables ht_insert_ttl stores the key without one and it never expires.
+
+#include <stddef.h>
+
+#include "hash_table.h"
+#include "server.h"
+
+#define HT_MEMCACHE_MAX_KEY 250 //memcached's own key limit
+#define HT_MEMCACHE_MAX_LINE 8192 //longest text command line, a get naming many keys included
+#define HT_MEMCACHE_BATCH 64 //keys handed to ht_search_batch at a time
+
+long ht_memcache_process(ht_hash_table* ht, const char* in, size_t len, ht_buf* out);
+
+#endif
@@ -0,0 +1,109 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#define _GNU_SOURCE //getcpu
+
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+
+#include "placement.h"
+
+//the nodes this thread's cpuset lets it allocate on, or just node 0 when the kernel has no NUMA support
+static void ht_numa_allowed(unsigned long mask[HT_NUMA_MASK_WORDS]) {
+    memset(mask, 0, HT_NUMA_MASK_WORDS * sizeof(unsigned long));
+    if (syscall(SYS_get_mempolicy, NULL, mask, HT_NUMA_MAX_NODES, NULL, MPOL_F_MEMS_ALLOWED) != 0) {
+        memset(mask, 0, HT_NUMA_MASK_WORDS * sizeof(unsigned long));
+        mask[0] = 1;
+    }
+}
+
+int ht_numa_nodes(int* nodes, const int max) {
+    unsigned long mask[HT_NUMA_MASK_WORDS];
+    ht_numa_allowed(mask);
+    int n = 0;
+    for (int node = 0; node < HT_NUMA_MAX_NODES && n < max; node++) {
+        if (mask[node / (8 * sizeof(unsigned long))] & (1UL << (node % (8 * sizeof(unsigned long))))) {
+            nodes[n++] = node;
+        }
+    }
+    return n;
+}
+
+int ht_numa_node(void) {
+    unsigned int cpu = 0;
+    unsigned int node = 0;
+    if (getcpu(&cpu, &node) != 0 || node >= HT_NUMA_MAX_NODES) {
+        return 0;
+    }
+    return (int)node;
+}
+
+//the policy mode and node mask for numa, interleaving spreads pages over every allowed node
+static int ht_numa_policy(const int numa, unsigned long mask[HT_NUMA_MASK_WORDS]) {
+    memset(mask, 0, HT_NUMA_MASK_WORDS * sizeof(unsigned long));
+    if (numa == HT_NUMA_INTERLEAVE) {
+        ht_numa_allowed(mask);
+        return MPOL_INTERLEAVE;
+    }
+    if (numa >= 0 && numa < HT_NUMA_MAX_NODES) {
+        mask[numa / (8 * sizeof(unsigned long))] = 1UL << (numa % (8 * sizeof(unsigned long)));
+        return MPOL_PREFERRED; //rather than MPOL_BIND, a full node spills over instead of failing the allocation
+    }
+    return MPOL_DEFAULT;
+}
+
+int ht_numa_bind(void* addr, const size_t length, const int numa, const int move) {
+    unsigned long mask[HT_NUMA_MASK_WORDS];
+    const int mode = ht_numa_policy(numa, mask);
+    const unsigned long flags = move ? MPOL_MF_MOVE : 0;
+    //the kernel reads one node fewer than maxnode says
+    if (syscall(SYS_mbind, addr, length, mode, mode == MPOL_DEFAULT ? NULL : mask, HT_NUMA_MAX_NODES + 1, flags) != 0) {
+        return errno == ENOSYS ? 0 : -1;
+    }
+    return 0;
+}
+
+int ht_numa_prefer(const int numa) {
+    unsigned long mask[HT_NUMA_MASK_WORDS];
+    const int mode = ht_numa_policy(numa, mask);
+    if (syscall(SYS_set_mempolicy, mode, mode == MPOL_DEFAULT ? NULL : mask, HT_NUMA_MAX_NODES + 1) != 0) {
+        return errno == ENOSYS ? 0 : -1;
+    }
+    return 0;
+}
+
+int ht_numa_save(ht_numa_saved* saved) {
+    memset(saved, 0, sizeof(*saved));
+    if (syscall(SYS_get_mempolicy, &saved->mode, saved->mask, HT_NUMA_MAX_NODES, NULL, 0) != 0) {
+        saved->mode = MPOL_DEFAULT;
+        return errno == ENOSYS ? 0 : -1;
+    }
+    return 0;
+}
+
+int ht_numa_restore(const ht_numa_saved* saved) {
+    //the mode comes back with its MPOL_F_* flags, which set_mempolicy takes in the same place
+    const void* mask = saved->mode == MPOL_DEFAULT ? NULL : saved->mask;
+    if (syscall(SYS_set_mempolicy, saved->mode, mask, HT_NUMA_MAX_NODES + 1) != 0) {
+        return errno == ENOSYS ? 0 : -1;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+//NUMA memory placement through the kernel's memory policy calls directly, so the table does not depend on libnuma.
+//On a kernel without NUMA support everything here reports a single node 0 and placement requests are no-ops.
+
+#include <stddef.h>
+
+#include "hash_table.h" //HT_NUMA_ANY, HT_NUMA_INTERLEAVE
+
+#define HT_NUMA_MAX_NODES 1024
+#define HT_NUMA_MASK_WORDS (HT_NUMA_MAX_NODES / (8 * sizeof(unsigned long)))
+
+//a thread's memory policy as ht_numa_save found it
+typedef struct {
+    int mode;
+    unsigned long mask[HT_NUMA_MASK_WORDS];
+} ht_numa_saved;
+
+//fills nodes with the ids of the nodes the calling thread may allocate on, ascending, and returns how many there are
+int ht_numa_nodes(int* nodes, const int max);
+//the node of the CPU the caller is running on right now, 0 when that cannot be found out
+int ht_numa_node(void);
+//Applies numa (HT_NUMA_ANY, HT_NUMA_INTERLEAVE or a node id to prefer) to the page aligned range addr, length.
+//Pages not faulted in yet are placed when first touched; move also migrates the ones that already are.
+//Returns 0, or -1 with errno set.
+int ht_numa_bind(void* addr, const size_t length, const int numa, const int move);
+//sets the calling thread's default policy for new pages, HT_NUMA_ANY goes back to the system default
+int ht_numa_prefer(const int numa);
+//Saves the calling thread's policy for new pages, whatever set it, so that ht_numa_restore can put it back after
+//ht_numa_prefer. Both return 0, or -1 with errno set.
+int ht_numa_save(ht_numa_saved* saved);
+int ht_numa_restore(const ht_numa_saved* saved);
+
+#endif
@@ -31,7 +31,8 @@ int is_prime(const int x) {
     if (x < 2) { return -1; }
     if (x < 4) { return 1; }
     if ((x % 2) == 0) { return 0; }
-    for (int i = 3; i <= floor(sqrt((double) x)); i += 2) {
+    const int limit = (int)floor(sqrt((double) x)); //once, not on every pass of the loop
+    for (int i = 3; i <= limit; i += 2) {
         if ((x % i) == 0) {
             return 0;
         }
@@ -0,0 +1,177 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_table_internal.h"
+#include "placement.h"
+#include "replica.h"
+
+#define HT_REPLICA_MAX 64
+#define HT_REPLICA_READERS 64 //reader counters per replica, threads beyond this many share them
+
+//lookups in progress by the threads using this counter, each on a cache line of its own
+typedef struct {
+    _Alignas(HT_CACHE_LINE) int active;
+} ht_reader_slot;
+
+//A lookup marks itself active on its thread's counter and then checks writing; a writer sets writing and then waits
+//for every counter to drop to 0. Both sides use sequentially consistent operations, so either the reader sees the
+//writer and backs off or the writer sees the reader and waits for it. Readers only ever write their own counter.
+typedef struct {
+    _Alignas(HT_CACHE_LINE) ht_hash_table* table;
+    int node;
+    int writing;
+    ht_reader_slot readers[HT_REPLICA_READERS];
+} ht_replica;
+
+static int ht_reader_next;
+static _Thread_local int ht_reader_index = -1;
+
+struct ht_replicated {
+    ht_replica* replicas;
+    int count;
+    pthread_mutex_t write_lock; //one writer at a time, so every replica sees the writes in the same order
+    short by_node[HT_NUMA_MAX_NODES]; //replica serving each node id
+};
+
+ht_replicated* ht_replicated_new(void) {
+    int nodes[HT_REPLICA_MAX];
+    const int count = ht_numa_nodes(nodes, HT_REPLICA_MAX);
+    ht_replicated* r = ht_calloc(1, sizeof(ht_replicated));
+    r->replicas = ht_aligned_alloc(HT_CACHE_LINE, sizeof(ht_replica) * (size_t)count);
+    memset(r->replicas, 0, sizeof(ht_replica) * (size_t)count);
+    r->count = count;
+    pthread_mutex_init(&r->write_lock, NULL);
+    for (int i = 0; i < count; i++) {
+        ht_replica* replica = &r->replicas[i];
+        replica->node = nodes[i];
+        replica->table = ht_new();
+        ht_set_numa(replica->table, nodes[i]);
+    }
+    //a node without a replica of its own, one the thread was not allowed when this ran, shares the first
+    memset(r->by_node, 0, sizeof(r->by_node));
+    for (int i = 0; i < count; i++) {
+        r->by_node[nodes[i]] = (short)i;
+    }
+    return r;
+}
+
+void ht_replicated_free(ht_replicated* r) {
+    for (int i = 0; i < r->count; i++) {
+        ht_delete_hash_table(r->replicas[i].table);
+    }
+    pthread_mutex_destroy(&r->write_lock);
+    free(r->replicas);
+    free(r);
+}
+
+int ht_replicated_replicas(const ht_replicated* r) {
+    return r->count;
+}
+
+ht_hash_table* ht_replicated_table(ht_replicated* r, const int node) {
+    return r->replicas[r->by_node[node >= 0 && node < HT_NUMA_MAX_NODES ? node : 0]].table;
+}
+
+//the calling thread's reader counter in replica, handed out round robin on first use
+static ht_reader_slot* ht_reader_slot_of(ht_replica* replica) {
+    if (ht_reader_index < 0) {
+        ht_reader_index = __atomic_fetch_add(&ht_reader_next, 1, __ATOMIC_RELAXED) % HT_REPLICA_READERS;
+    }
+    return &replica->readers[ht_reader_index];
+}
+
+//waits out the lookups in progress on replica and keeps new ones off it until ht_replica_write_end
+static void ht_replica_write_begin(ht_replica* replica) {
+    __atomic_store_n(&replica->writing, 1, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < HT_REPLICA_READERS; i++) {
+        while (__atomic_load_n(&replica->readers[i].active, __ATOMIC_SEQ_CST) != 0) {
+            sched_yield();
+        }
+    }
+}
+
+static void ht_replica_write_end(ht_replica* replica) {
+    __atomic_store_n(&replica->writing, 0, __ATOMIC_RELEASE);
+}
+
+//Runs a write against every replica, with new pages the allocator faults in for it coming from that replica's node.
+//The thread's own memory policy is put back afterwards.
+static int ht_replicated_write(ht_replicated* r, const char* key, const char* value) {
+    int result = 0;
+    ht_numa_saved saved;
+    pthread_mutex_lock(&r->write_lock);
+    const int restore = r->count > 1 && ht_numa_save(&saved) == 0;
+    for (int i = 0; i < r->count; i++) {
+        ht_replica* replica = &r->replicas[i];
+        if (restore) {
+            ht_numa_prefer(replica->node);
+        }
+        ht_replica_write_begin(replica);
+        if (value != NULL) {
+            ht_insert(replica->table, key, value);
+        } else {
+            result = ht_delete(replica->table, key);
+        }
+        ht_replica_write_end(replica);
+    }
+    if (restore) {
+        ht_numa_restore(&saved);
+    }
+    pthread_mutex_unlock(&r->write_lock);
+    return result;
+}
+
+void ht_replicated_insert(ht_replicated* r, const char* key, const char* value) {
+    ht_replicated_write(r, key, value);
+}
+
+int ht_replicated_delete(ht_replicated* r, const char* key) {
+    return ht_replicated_write(r, key, NULL);
+}
+
+//ht_search_shared rather than ht_search, which updates the probe statistics and so cannot run alongside other readers
+long ht_replicated_search(ht_replicated* r, const char* key, char* value, const size_t size) {
+    ht_replica* replica = &r->replicas[r->by_node[ht_numa_node()]];
+    ht_reader_slot* slot = ht_reader_slot_of(replica);
+    long length = -1;
+    for (;;) {
+        __atomic_add_fetch(&slot->active, 1, __ATOMIC_SEQ_CST);
+        if (!__atomic_load_n(&replica->writing, __ATOMIC_SEQ_CST)) {
+            break;
+        }
+        __atomic_sub_fetch(&slot->active, 1, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&replica->writing, __ATOMIC_ACQUIRE)) {
+            sched_yield();
+        }
+    }
+    const ht_item* item = ht_search_shared(replica->table, key);
+    if (item != NULL) {
+        length = (long)strlen(item->value);
+        if (size > 0) {
+            const size_t n = (size_t)length < size - 1 ? (size_t)length : size - 1;
+            memcpy(value, item->value, n);
+            value[n] = '\0';
+        }
+    }
+    __atomic_sub_fetch(&slot->active, 1, __ATOMIC_RELEASE);
+    return length;
+}
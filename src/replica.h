@@ -0,0 +1,48 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#ifndef REPLICA_H
+#define REPLICA_H
+
+//Read-mostly table replicated once per NUMA node, so that every lookup of the slot array stays in memory local to the
+//CPU doing it. Writes go to every replica in turn, with the writing thread's memory policy set to prefer that
+//replica's node. That only steers pages the allocator newly faults in: items and strings carved out of heap pages it
+//already has stay wherever those pages are, so they end up on the replica's node only as far as the heap grows during
+//the write. Lookups go to the replica on the caller's current node and copy the value out, since a later write may
+//free it. A lookup writes only a per-thread counter of that replica, so readers on a node share no written cache line;
+//a write waits for the lookups in progress on each replica to finish and holds new ones off while it runs.
+//Writes cost one table update per node plus that wait each, so this only pays off when reads dominate.
+
+#include <stddef.h>
+
+#include "hash_table.h"
+
+typedef struct ht_replicated ht_replicated;
+
+//one replica per NUMA node the calling thread may allocate on, a single one on a machine without NUMA
+ht_replicated* ht_replicated_new(void);
+void ht_replicated_free(ht_replicated* r);
+int ht_replicated_replicas(const ht_replicated* r);
+//the replica serving node, for ht_stats and the like, only safe to use while nothing writes
+ht_hash_table* ht_replicated_table(ht_replicated* r, const int node);
+void ht_replicated_insert(ht_replicated* r, const char* key, const char* value);
+int ht_replicated_delete(ht_replicated* r, const char* key);
+//Copies the value of key into value as snprintf would, truncated to size - 1 characters and terminated.
+//Returns the value's full length, or -1 when key is missing. Safe to call from any number of threads.
+long ht_replicated_search(ht_replicated* r, const char* key, char* value, const size_t size);
+
+#endif
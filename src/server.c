@@ -0,0 +1,482 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#define _GNU_SOURCE //accept4
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "hash_table_internal.h"
+#include "server.h"
+#include "server_internal.h"
+
+#define HT_SERVER_EVENTS 256 //epoll events taken per wait
+#define HT_SERVER_ACCEPT_RETRY_MS 100 //how long a listener out of file descriptors waits, unless a connection closes
+
+void ht_buf_reserve(ht_buf* buf, const size_t extra) {
+    if (buf->cap - buf->len >= extra) {
+        return;
+    }
+    size_t cap = buf->cap > 0 ? buf->cap : 4096;
+    while (cap - buf->len < extra) {
+        cap *= 2;
+    }
+    char* data = realloc(buf->data, cap);
+    if (data == NULL) {
+        abort(); //as ht_malloc does, a connection has no way to carry on without its buffer
+    }
+    buf->data = data;
+    buf->cap = cap;
+}
+
+void ht_buf_append(ht_buf* buf, const void* data, const size_t len) {
+    if (len == 0) {
+        return;
+    }
+    ht_buf_reserve(buf, len);
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+}
+
+//drops the first len bytes
+void ht_buf_consume(ht_buf* buf, const size_t len) {
+    memmove(buf->data, buf->data + len, buf->len - len);
+    buf->len -= len;
+}
+
+void ht_buf_free(ht_buf* buf) {
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+void ht_binary_respond(ht_buf* out, const uint8_t status, const char* value, const uint32_t value_len) {
+    ht_response_header header = {status, {0, 0, 0}, value_len};
+    ht_buf_reserve(out, sizeof(header) + value_len);
+    memcpy(out->data + out->len, &header, sizeof(header));
+    if (value_len > 0) {
+        memcpy(out->data + out->len + sizeof(header), value, value_len);
+    }
+    out->len += sizeof(header) + value_len;
+}
+
+//ht_upsert callback of SET: the value was already copied out of the input buffer, the table takes it as it is
+static char* ht_take_value(const char* key, char* current, void* ctx) {
+    (void)key;
+    (void)current;
+    return ctx;
+}
+
+//Executes one request, its key already copied out NUL terminated and its value checked for NUL bytes, and appends
+//the response to out.
+void ht_binary_execute(ht_hash_table* ht, const uint8_t op, const char* key, const char* v, const uint32_t value_len,
+                       ht_buf* out) {
+    if (op == HT_OP_GET) {
+        const char* value = ht_search(ht, key);
+        if (value != NULL) {
+            ht_binary_respond(out, HT_STATUS_OK, value, (uint32_t)strlen(value));
+        } else {
+            ht_binary_respond(out, HT_STATUS_NOT_FOUND, NULL, 0);
+        }
+    } else if (op == HT_OP_SET) {
+        char* value = ht_malloc((size_t)value_len + 1);
+        memcpy(value, v, value_len);
+        value[value_len] = '\0';
+        ht_upsert(ht, key, ht_take_value, value);
+        ht_binary_respond(out, HT_STATUS_OK, NULL, 0);
+    } else if (op == HT_OP_DEL) {
+        ht_binary_respond(out, ht_delete(ht, key) ? HT_STATUS_OK : HT_STATUS_NOT_FOUND, NULL, 0);
+    } else {
+        ht_binary_respond(out, HT_STATUS_ERROR, NULL, 0);
+    }
+}
+
+long ht_binary_process(ht_hash_table* ht, const char* in, const size_t len, ht_buf* out) {
+    char key[HT_SERVER_MAX_KEY + 1];
+    size_t off = 0;
+    while (len - off >= sizeof(ht_request_header)) {
+        ht_request_header header;
+        memcpy(&header, in + off, sizeof(header));
+        if (header.key_len == 0 || header.key_len > HT_SERVER_MAX_KEY || header.value_len > HT_SERVER_MAX_VALUE) {
+            return -1;
+        }
+        const size_t total = sizeof(header) + header.key_len + header.value_len;
+        if (len - off < total) {
+            break;
+        }
+        const char* k = in + off + sizeof(header);
+        const char* v = k + header.key_len;
+        off += total;
+        if (memchr(k, '\0', header.key_len) != NULL || memchr(v, '\0', header.value_len) != NULL) {
+            ht_binary_respond(out, HT_STATUS_ERROR, NULL, 0);
+            continue;
+        }
+        memcpy(key, k, header.key_len);
+        key[header.key_len] = '\0';
+        ht_binary_execute(ht, header.op, key, v, header.value_len, out);
+    }
+    return (long)off;
+}
+
+ht_server* ht_server_new(ht_hash_table* ht) {
+    ht_server* server = ht_calloc(1, sizeof(ht_server));
+    server->ht = ht;
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->wake.kind = HT_ENDPOINT_WAKE;
+    server->wake.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (server->epoll_fd < 0 || server->wake.fd < 0) {
+        ht_server_free(server);
+        return NULL;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &server->wake};
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake.fd, &ev) < 0) {
+        ht_server_free(server);
+        return NULL;
+    }
+    return server;
+}
+
+//Closes the listening sockets and removes their socket files.
+//Connections still open when ht_server_run returns are closed by it.
+void ht_server_free(ht_server* server) {
+    for (int i = 0; i < server->num_listeners; i++) {
+        close(server->listeners[i].endpoint.fd);
+        if (server->listeners[i].path[0] != '\0') {
+            unlink(server->listeners[i].path);
+        }
+    }
+    if (server->wake.fd >= 0) {
+        close(server->wake.fd);
+    }
+    if (server->epoll_fd >= 0) {
+        close(server->epoll_fd);
+    }
+    free(server);
+}
+
+//makes the listening socket fd the server's next listener, or closes it and removes its socket file (path, empty for
+//none) if epoll will not take it; returns 0, or -1 with errno set
+static int ht_server_add_listener(ht_server* server, const int fd, ht_protocol_fn protocol, const char* path) {
+    ht_listener* listener = &server->listeners[server->num_listeners];
+    listener->endpoint.kind = HT_ENDPOINT_LISTENER;
+    listener->endpoint.fd = fd;
+    listener->protocol = protocol;
+    listener->paused = 0;
+    strcpy(listener->path, path);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = listener};
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        const int saved = errno;
+        close(fd);
+        if (path[0] != '\0') {
+            unlink(path);
+        }
+        errno = saved;
+        return -1;
+    }
+    server->num_listeners++;
+    return 0;
+}
+
+//Listens on a Unix domain socket at path, replacing a stale socket file left there, and serves connections to it
+//with protocol. Returns 0, or -1 with errno set.
+int ht_server_listen_unix(ht_server* server, const char* path, ht_protocol_fn protocol) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (server->num_listeners == HT_SERVER_MAX_LISTENERS || strlen(path) >= sizeof(addr.sun_path)) {
+        errno = EINVAL;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        const int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return ht_server_add_listener(server, fd, protocol, path);
+}
+
+//Listens on TCP at the IPv4 address host (e.g. "127.0.0.1" to stay on the loopback) and port, and serves connections
+//to it with protocol. Returns 0, or -1 with errno set.
+int ht_server_listen_tcp(ht_server* server, const char* host, const int port, ht_protocol_fn protocol) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (server->num_listeners == HT_SERVER_MAX_LISTENERS || port <= 0 || port > 65535 ||
+        inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        errno = EINVAL;
+        return -1;
+    }
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    //responses go out in one write per batch of requests, waiting to coalesce them further only adds latency;
+    //accepted sockets inherit both options from the listener
+    const int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        const int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return ht_server_add_listener(server, fd, protocol, "");
+}
+
+//a new connection on the server's list, owning fd
+ht_conn* ht_conn_new(ht_server* server, const int fd, ht_protocol_fn protocol) {
+    ht_conn* conn = ht_calloc(1, sizeof(ht_conn));
+    conn->endpoint.kind = HT_ENDPOINT_CONN;
+    conn->endpoint.fd = fd;
+    conn->protocol = protocol;
+    conn->next = server->conns;
+    if (conn->next != NULL) {
+        conn->next->prev = conn;
+    }
+    server->conns = conn;
+    return conn;
+}
+
+//closes the connection's socket, which also takes it out of the epoll set, and frees it
+void ht_conn_free(ht_server* server, ht_conn* conn) {
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        server->conns = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+    close(conn->endpoint.fd);
+    ht_buf_free(&conn->in);
+    ht_buf_free(&conn->out);
+    ht_buf_free(&conn->out_next);
+    free(conn);
+}
+
+//returns -1 if epoll would not change what the connection is watched for
+static int ht_conn_watch(ht_server* server, ht_conn* conn, const int want_write) {
+    if (conn->want_write == want_write) {
+        return 0;
+    }
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLET | (want_write ? EPOLLOUT : 0), .data.ptr = conn};
+    server->syscalls++;
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, conn->endpoint.fd, &ev) < 0) {
+        return -1;
+    }
+    conn->want_write = want_write;
+    return 0;
+}
+
+//writes as much queued output as the socket takes, returns -1 if the connection broke
+static int ht_conn_flush(ht_server* server, ht_conn* conn) {
+    while (conn->out_sent < conn->out.len) {
+        server->syscalls++;
+        const ssize_t n = send(conn->endpoint.fd, conn->out.data + conn->out_sent, conn->out.len - conn->out_sent,
+                               MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return ht_conn_watch(server, conn, 1);
+            }
+            return -1;
+        }
+        conn->out_sent += (size_t)n;
+    }
+    conn->out.len = 0;
+    conn->out_sent = 0;
+    return ht_conn_watch(server, conn, 0);
+}
+
+//Reads until the socket is drained, executing complete requests after every read, then sends all the responses
+//in one go. Returns -1 once the connection is finished with.
+static int ht_conn_read(ht_server* server, ht_conn* conn) {
+    for (;;) {
+        conn->throttled = 0;
+        for (;;) {
+            if (conn->out.len - conn->out_sent >= HT_SERVER_MAX_PENDING) {
+                //the peer is not reading its responses, leave the rest of its requests in the socket for now
+                conn->throttled = 1;
+                break;
+            }
+            ht_buf_reserve(&conn->in, HT_SERVER_READ_SIZE);
+            server->syscalls++;
+            const ssize_t n = recv(conn->endpoint.fd, conn->in.data + conn->in.len, conn->in.cap - conn->in.len, 0);
+            if (n == 0) {
+                return -1;
+            }
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                return -1;
+            }
+            conn->in.len += (size_t)n;
+            const long used = conn->protocol(server->ht, conn->in.data, conn->in.len, &conn->out);
+            if (used < 0) {
+                return -1;
+            }
+            ht_buf_consume(&conn->in, (size_t)used);
+        }
+        if (ht_conn_flush(server, conn) < 0) {
+            return -1;
+        }
+        //edge triggered: input left behind by throttling is not signalled again, so go back for it ourselves
+        if (!conn->throttled || conn->out.len > 0) {
+            return 0;
+        }
+    }
+}
+
+//Takes a listener out of the epoll set. Its pending connection stays in the backlog, so the level triggered listener
+//would otherwise wake every wait for a connection accept cannot take.
+static void ht_server_pause(ht_server* server, ht_listener* listener) {
+    server->syscalls++;
+    if (!listener->paused && epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, listener->endpoint.fd, NULL) == 0) {
+        listener->paused = 1;
+        server->paused_listeners++;
+    }
+}
+
+//puts paused listeners back once a connection has closed or HT_SERVER_ACCEPT_RETRY_MS has passed, one that epoll
+//still refuses waits for the next chance
+static void ht_server_resume(ht_server* server) {
+    for (int i = 0; i < server->num_listeners; i++) {
+        ht_listener* listener = &server->listeners[i];
+        if (!listener->paused) {
+            continue;
+        }
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = listener};
+        server->syscalls++;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, listener->endpoint.fd, &ev) == 0) {
+            listener->paused = 0;
+            server->paused_listeners--;
+        }
+    }
+}
+
+static void ht_server_accept(ht_server* server, ht_listener* listener) {
+    for (;;) {
+        server->syscalls++;
+        const int fd = accept4(listener->endpoint.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                ht_server_pause(server, listener);
+            }
+            return; //EAGAIN once the backlog is empty, anything else is the client's problem
+        }
+        ht_conn* conn = ht_conn_new(server, fd, listener->protocol);
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLET, .data.ptr = conn};
+        server->syscalls++;
+        if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            ht_conn_free(server, conn); //never to be woken for, it would sit open forever
+        }
+    }
+}
+
+//Serves every listener until ht_server_stop is called. Returns 0, or -1 with errno set if epoll failed.
+int ht_server_run(ht_server* server) {
+    struct epoll_event events[HT_SERVER_EVENTS];
+    while (!server->stopping) {
+        server->syscalls++;
+        const int timeout = server->paused_listeners > 0 ? HT_SERVER_ACCEPT_RETRY_MS : -1;
+        const int n = epoll_wait(server->epoll_fd, events, HT_SERVER_EVENTS, timeout);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        int closed = 0;
+        for (int i = 0; i < n; i++) {
+            ht_endpoint* endpoint = events[i].data.ptr;
+            if (endpoint->kind == HT_ENDPOINT_LISTENER) {
+                ht_server_accept(server, (ht_listener*)endpoint);
+                continue;
+            }
+            if (endpoint->kind == HT_ENDPOINT_WAKE) {
+                continue;
+            }
+            ht_conn* conn = (ht_conn*)endpoint;
+            int result = 0;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                result = -1;
+            }
+            if (result == 0 && (events[i].events & EPOLLOUT)) {
+                result = ht_conn_flush(server, conn);
+                if (result == 0 && conn->throttled && conn->out.len == 0) {
+                    result = ht_conn_read(server, conn); //edge triggered, the unread input will not be signalled again
+                    events[i].events &= ~(uint32_t)EPOLLIN;
+                }
+            }
+            if (result == 0 && (events[i].events & EPOLLIN)) {
+                result = ht_conn_read(server, conn);
+            }
+            if (result < 0) {
+                ht_conn_free(server, conn);
+                closed++;
+            }
+        }
+        if (server->paused_listeners > 0 && (n == 0 || closed > 0)) {
+            ht_server_resume(server);
+        }
+    }
+    while (server->conns != NULL) {
+        ht_conn_free(server, server->conns);
+    }
+    return 0;
+}
+
+//system calls made serving requests so far, for comparing the epoll and io_uring loops
+unsigned long long ht_server_syscalls(const ht_server* server) {
+    return server->syscalls;
+}
+
+//Makes ht_server_run return, safe to call from a signal handler or another thread.
+void ht_server_stop(ht_server* server) {
+    server->stopping = 1;
+    const uint64_t one = 1;
+    ssize_t ignored = write(server->wake.fd, &one, sizeof(one));
+    (void)ignored;
+}
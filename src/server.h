@@ -0,0 +1,97 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#ifndef SERVER_H
+#define SERVER_H
+
+//A single threaded key-value server that owns one ht_hash_table and serves it to other processes.
+//
+//The wire protocol is binary and pipelined: a client may send any number of requests without waiting, and the
+//responses come back in the same order. Each read drains the socket, every complete request in it is executed and
+//all their responses go out in one write, so a deep pipeline costs a handful of syscalls per batch, not per request.
+//
+//Request:  ht_request_header, then key_len bytes of key, then value_len bytes of value (SET only, 0 otherwise)
+//Response: ht_response_header, then value_len bytes of value (a GET that found its key, 0 otherwise)
+//Integers are in host byte order, the socket being local. Keys and values are stored as C strings, so a request
+//whose key or value contains a NUL byte gets HT_STATUS_ERROR.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash_table.h"
+
+#define HT_OP_GET 1
+#define HT_OP_SET 2
+#define HT_OP_DEL 3
+
+#define HT_STATUS_OK 0
+#define HT_STATUS_NOT_FOUND 1 //GET or DEL of a missing key
+#define HT_STATUS_ERROR 2 //bad op or a NUL byte in the key or value
+
+#define HT_SERVER_MAX_KEY 4096
+#define HT_SERVER_MAX_VALUE (16 << 20)
+#define HT_SERVER_MAX_LISTENERS 4
+#define HT_SERVER_READ_SIZE 65536 //free space made in a connection's input buffer before each read
+#define HT_SERVER_MAX_PENDING (4 << 20) //output a slow reader may leave queued before its input stops being read
+
+typedef struct {
+    uint8_t op; //HT_OP_*
+    uint8_t reserved;
+    uint16_t key_len;
+    uint32_t value_len;
+} ht_request_header;
+
+typedef struct {
+    uint8_t status; //HT_STATUS_*
+    uint8_t reserved[3];
+    uint32_t value_len;
+} ht_response_header;
+
+//growable byte buffer for connection input and output
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} ht_buf;
+
+void ht_buf_reserve(ht_buf* buf, size_t extra);
+void ht_buf_append(ht_buf* buf, const void* data, size_t len);
+void ht_buf_consume(ht_buf* buf, size_t len);
+void ht_buf_free(ht_buf* buf);
+
+//Executes every complete request at the start of in against ht and appends the responses to out.
+//Returns the bytes consumed, the tail of a request still arriving is left for the next call, or -1 when the stream
+//cannot be parsed and the connection should be dropped.
+typedef long (*ht_protocol_fn)(ht_hash_table* ht, const char* in, size_t len, ht_buf* out);
+
+long ht_binary_process(ht_hash_table* ht, const char* in, size_t len, ht_buf* out);
+void ht_binary_execute(ht_hash_table* ht, uint8_t op, const char* key, const char* value, uint32_t value_len,
+                       ht_buf* out);
+void ht_binary_respond(ht_buf* out, uint8_t status, const char* value, uint32_t value_len);
+
+typedef struct ht_server ht_server;
+
+ht_server* ht_server_new(ht_hash_table* ht);
+void ht_server_free(ht_server* server);
+int ht_server_listen_unix(ht_server* server, const char* path, ht_protocol_fn protocol);
+int ht_server_listen_tcp(ht_server* server, const char* host, const int port, ht_protocol_fn protocol);
+int ht_server_run(ht_server* server);
+int ht_server_run_uring(ht_server* server);
+void ht_server_stop(ht_server* server);
+unsigned long long ht_server_syscalls(const ht_server* server);
+
+#endif
@@ -0,0 +1,79 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#ifndef SERVER_INTERNAL_H
+#define SERVER_INTERNAL_H
+
+//state the epoll loop in server.c shares with the io_uring loop in server_uring.c, not part of the public API
+
+#include <sys/un.h>
+
+#include "server.h"
+
+#define HT_ENDPOINT_LISTENER 0
+#define HT_ENDPOINT_CONN 1
+#define HT_ENDPOINT_WAKE 2
+
+//what an epoll event's data pointer refers to, the first member of both listeners and connections
+typedef struct {
+    int kind; //HT_ENDPOINT_*
+    int fd;
+} ht_endpoint;
+
+typedef struct {
+    ht_endpoint endpoint;
+    ht_protocol_fn protocol;
+    char path[sizeof(((struct sockaddr_un*)NULL)->sun_path)]; //socket file to remove again, empty for other sockets
+    int paused; //out of the epoll set while accept has no file descriptor to give a connection
+} ht_listener;
+
+typedef struct ht_conn {
+    ht_endpoint endpoint;
+    ht_protocol_fn protocol;
+    struct ht_conn* prev; //every open connection is on the server's list
+    struct ht_conn* next;
+    ht_buf in;
+    ht_buf out;
+    size_t out_sent; //bytes at the start of out already written
+    int want_write; //EPOLLOUT is in the interest set
+    int throttled; //input left unread because out reached HT_SERVER_MAX_PENDING
+    //io_uring loop only
+    ht_buf out_next; //responses made while a send of out is in flight, the kernel may read out until it completes
+    int inflight; //operations submitted for this connection and not completed yet, it is freed once this is 0
+    int sending; //a send of out is in flight
+    int receiving; //a multishot recv is armed
+    int closing;
+    struct ht_conn* dirty; //next connection with responses to send after the current batch of completions
+    int queued; //on the dirty list
+} ht_conn;
+
+struct ht_server {
+    ht_hash_table* ht;
+    int epoll_fd;
+    ht_endpoint wake; //eventfd written by ht_server_stop
+    ht_listener listeners[HT_SERVER_MAX_LISTENERS];
+    int num_listeners;
+    int paused_listeners;
+    ht_conn* conns;
+    unsigned long long syscalls;
+    volatile int stopping;
+};
+
+ht_conn* ht_conn_new(ht_server* server, int fd, ht_protocol_fn protocol);
+void ht_conn_free(ht_server* server, ht_conn* conn);
+
+#endif
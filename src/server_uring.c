@@ -0,0 +1,513 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "server.h"
+#include "server_internal.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+
+//io_uring event loop for the same listeners and protocols as ht_server_run. Talks to the kernel through the raw
+//system calls, liburing is not required. Each listener has one multishot accept and each connection one multishot
+//recv drawing from a ring of provided buffers registered with the kernel, so neither is resubmitted per event.
+//Sends for every connection that produced responses in a batch of completions go out together with the wait for
+//the next batch in a single io_uring_enter, which is how a busy server gets well below one system call per request.
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define HT_URING_ENTRIES 4096 //submission queue entries, the completion queue gets four times as many
+#define HT_URING_BUFS 1024 //provided receive buffers, a power of two
+#define HT_URING_BUF_SIZE 16384
+#define HT_URING_GROUP 0 //buffer group id of the receive buffers
+#define HT_URING_ACCEPT_RETRY_MS 100 //wait before accepting again after running out of file descriptors
+
+//what a completion is for, kept in the low bits of its user_data next to the listener or connection pointer
+#define HT_URING_ACCEPT 1
+#define HT_URING_RECV 2
+#define HT_URING_SEND 3
+#define HT_URING_WAKE 4
+#define HT_URING_CANCEL 5
+#define HT_URING_RETRY 6
+#define HT_URING_KIND_MASK 7ULL
+
+typedef struct {
+    int fd;
+    unsigned sq_entries;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned sq_local_tail; //entries filled in, published to *sq_tail by ht_uring_enter
+    unsigned sq_submitted;
+    struct io_uring_sqe* sqes;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring; //the same mapping as sq_ring with IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size;
+    size_t sqes_size;
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    unsigned short buf_tail;
+    char* bufs;
+    uint64_t wake_value; //target of the read on the server's eventfd
+    ht_server* server;
+} ht_uring;
+
+static int ht_uring_setup(ht_uring* ring, const unsigned flags) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = flags | IORING_SETUP_CQSIZE;
+    params.cq_entries = HT_URING_ENTRIES * 4;
+    ring->fd = (int)syscall(__NR_io_uring_setup, HT_URING_ENTRIES, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+    ring->sq_entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                         IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        return -1;
+    }
+    ring->cq_ring = ring->sq_ring;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                             IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            return -1;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        return -1;
+    }
+    char* sq = ring->sq_ring;
+    char* cq = ring->cq_ring;
+    ring->sq_head = (unsigned*)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->sq_submitted = ring->sq_local_tail;
+    //submission entries are always used in ring order, so the indirection array is the identity
+    unsigned* array = (unsigned*)(sq + params.sq_off.array);
+    for (unsigned i = 0; i < params.sq_entries; i++) {
+        array[i] = i;
+    }
+    ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+static void ht_uring_free(ht_uring* ring) {
+    if (ring->buf_ring != NULL && ring->buf_ring != MAP_FAILED) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+    }
+    free(ring->bufs);
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd); //cancels whatever is still pending
+    }
+}
+
+//Submits what has been queued and, with wait, blocks until at least one completion is there.
+static int ht_uring_enter(ht_uring* ring, const unsigned wait) {
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    const unsigned to_submit = ring->sq_local_tail - ring->sq_submitted;
+    ring->server->syscalls++;
+    const int n = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, wait, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (n < 0) {
+        //interrupted, or the completion queue is full and has to be drained before anything else goes in
+        return errno == EINTR || errno == EBUSY || errno == EAGAIN ? 0 : -1;
+    }
+    ring->sq_submitted += (unsigned)n;
+    return 0;
+}
+
+//the next free submission entry, zeroed, submitting the queue first if it is full
+static struct io_uring_sqe* ht_uring_sqe(ht_uring* ring, const int kind, void* owner) {
+    while (ring->sq_local_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        ht_uring_enter(ring, 0);
+    }
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    ring->sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = (uint64_t)(uintptr_t)owner | (uint64_t)kind;
+    return sqe;
+}
+
+//hands receive buffer bid back to the kernel
+static void ht_uring_recycle(ht_uring* ring, const unsigned bid) {
+    struct io_uring_buf* buf = &ring->buf_ring->bufs[ring->buf_tail & (HT_URING_BUFS - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring->bufs + (size_t)bid * HT_URING_BUF_SIZE);
+    buf->len = HT_URING_BUF_SIZE;
+    buf->bid = (uint16_t)bid;
+    ring->buf_tail++;
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+static int ht_uring_setup_buffers(ht_uring* ring) {
+    ring->buf_ring_size = HT_URING_BUFS * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ring->bufs = malloc((size_t)HT_URING_BUFS * HT_URING_BUF_SIZE);
+    if (ring->buf_ring == MAP_FAILED || ring->bufs == NULL) {
+        return -1;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = HT_URING_BUFS;
+    reg.bgid = HT_URING_GROUP;
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return -1;
+    }
+    for (unsigned bid = 0; bid < HT_URING_BUFS; bid++) {
+        ht_uring_recycle(ring, bid);
+    }
+    return 0;
+}
+
+static void ht_uring_accept(ht_uring* ring, ht_listener* listener) {
+    struct io_uring_sqe* sqe = ht_uring_sqe(ring, HT_URING_ACCEPT, listener);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listener->endpoint.fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+}
+
+//Rearms the listener's accept after HT_URING_ACCEPT_RETRY_MS. Rearming at once after running out of file descriptors
+//would fail straight away again for the connection still waiting, over and over.
+static void ht_uring_retry_accept(ht_uring* ring, ht_listener* listener) {
+    static const struct __kernel_timespec delay = {0, HT_URING_ACCEPT_RETRY_MS * 1000000LL};
+    struct io_uring_sqe* sqe = ht_uring_sqe(ring, HT_URING_RETRY, listener);
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&delay;
+    sqe->len = 1;
+}
+
+static void ht_uring_recv(ht_uring* ring, ht_conn* conn) {
+    struct io_uring_sqe* sqe = ht_uring_sqe(ring, HT_URING_RECV, conn);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->endpoint.fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = HT_URING_GROUP;
+    conn->receiving = 1;
+    conn->inflight++;
+}
+
+//ends the connection's multishot recv, which completes with -ECANCELED
+static void ht_uring_cancel_recv(ht_uring* ring, ht_conn* conn) {
+    struct io_uring_sqe* sqe = ht_uring_sqe(ring, HT_URING_CANCEL, conn);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)conn | HT_URING_RECV;
+    conn->inflight++;
+}
+
+static void ht_uring_send(ht_uring* ring, ht_conn* conn) {
+    struct io_uring_sqe* sqe = ht_uring_sqe(ring, HT_URING_SEND, conn);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->endpoint.fd;
+    sqe->addr = (uint64_t)(uintptr_t)(conn->out.data + conn->out_sent);
+    sqe->len = (unsigned)(conn->out.len - conn->out_sent);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    conn->sending = 1;
+    conn->inflight++;
+}
+
+static void ht_uring_wake(ht_uring* ring) {
+    struct io_uring_sqe* sqe = ht_uring_sqe(ring, HT_URING_WAKE, &ring->wake_value);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = ring->server->wake.fd;
+    sqe->addr = (uint64_t)(uintptr_t)&ring->wake_value;
+    sqe->len = sizeof(ring->wake_value);
+}
+
+//Starts tearing a connection down. Shutting the socket down ends its multishot recv, the connection is freed once
+//nothing submitted for it is outstanding and it is off the dirty list.
+static void ht_uring_close(ht_uring* ring, ht_conn* conn) {
+    if (!conn->closing) {
+        conn->closing = 1;
+        ring->server->syscalls++;
+        shutdown(conn->endpoint.fd, SHUT_RDWR);
+    }
+    if (conn->inflight == 0 && !conn->queued) {
+        ht_conn_free(ring->server, conn);
+    }
+}
+
+//where new responses go: out, or out_next while the kernel may still be reading out for a send
+static ht_buf* ht_uring_output(ht_conn* conn) {
+    return conn->sending ? &conn->out_next : &conn->out;
+}
+
+//responses made and not sent yet
+static size_t ht_uring_pending(const ht_conn* conn) {
+    return conn->out.len - conn->out_sent + conn->out_next.len;
+}
+
+//Stops reading from a connection whose peer is not reading its responses, as ht_conn_read does for the epoll loop.
+//Its recv is cancelled and whatever that still delivers waits in the input buffer until the responses drain.
+static void ht_uring_throttle(ht_uring* ring, ht_conn* conn) {
+    if (conn->throttled || ht_uring_pending(conn) < HT_SERVER_MAX_PENDING) {
+        return;
+    }
+    conn->throttled = 1;
+    if (conn->receiving) {
+        ht_uring_cancel_recv(ring, conn);
+    }
+}
+
+//runs the complete requests waiting in the input buffer
+static int ht_uring_process(ht_server* server, ht_conn* conn) {
+    const long used = conn->protocol(server->ht, conn->in.data, conn->in.len, ht_uring_output(conn));
+    if (used < 0) {
+        return -1;
+    }
+    ht_buf_consume(&conn->in, (size_t)used);
+    return 0;
+}
+
+//runs the requests in one received buffer, parsing straight out of it when no partial request is waiting
+static int ht_uring_received(ht_uring* ring, ht_conn* conn, const char* data, const size_t len) {
+    if (conn->in.len == 0 && !conn->throttled) {
+        const long used = conn->protocol(ring->server->ht, data, len, ht_uring_output(conn));
+        if (used < 0) {
+            return -1;
+        }
+        ht_buf_append(&conn->in, data + used, len - (size_t)used);
+    } else {
+        ht_buf_append(&conn->in, data, len);
+        if (!conn->throttled && ht_uring_process(ring->server, conn) < 0) {
+            return -1;
+        }
+    }
+    ht_uring_throttle(ring, conn);
+    return 0;
+}
+
+//A send completed. The kernel is done with out, so the responses collected in out_next meanwhile join it; resumes
+//reading from a throttled connection once its responses drained below the limit.
+static int ht_uring_sent(ht_uring* ring, ht_conn* conn, const size_t sent) {
+    conn->out_sent += sent;
+    if (conn->out_sent == conn->out.len) {
+        const ht_buf drained = conn->out;
+        conn->out = conn->out_next;
+        conn->out_next = drained;
+        conn->out_next.len = 0;
+        conn->out_sent = 0;
+    } else {
+        ht_buf_append(&conn->out, conn->out_next.data, conn->out_next.len);
+        conn->out_next.len = 0;
+    }
+    if (conn->throttled && ht_uring_pending(conn) < HT_SERVER_MAX_PENDING) {
+        conn->throttled = 0;
+        if (ht_uring_process(ring->server, conn) < 0) {
+            return -1;
+        }
+        ht_uring_throttle(ring, conn);
+        if (!conn->throttled && !conn->receiving) {
+            ht_uring_recv(ring, conn);
+        }
+    }
+    return 0;
+}
+
+static void ht_uring_mark_dirty(ht_conn** dirty, ht_conn* conn) {
+    if (!conn->queued) {
+        conn->queued = 1;
+        conn->dirty = *dirty;
+        *dirty = conn;
+    }
+}
+
+//Serves every listener through io_uring until ht_server_stop is called. As in the epoll loop, a connection whose
+//unsent responses reach HT_SERVER_MAX_PENDING is not read from until they drain: its multishot recv is cancelled
+//and rearmed afterwards.
+//Returns 0, or -1 with errno set when io_uring is unavailable or fails (ENOSYS, EPERM under some sandboxes).
+int ht_server_run_uring(ht_server* server) {
+    ht_uring ring;
+    memset(&ring, 0, sizeof(ring));
+    ring.server = server;
+    ring.fd = -1;
+    //one thread owns the ring, which lets the kernel defer completion work until we ask for events
+    if (ht_uring_setup(&ring, IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN) < 0) {
+        ht_uring_free(&ring);
+        memset(&ring, 0, sizeof(ring));
+        ring.server = server;
+        ring.fd = -1;
+        if (ht_uring_setup(&ring, 0) < 0) {
+            const int saved = errno;
+            ht_uring_free(&ring);
+            errno = saved;
+            return -1;
+        }
+    }
+    if (ht_uring_setup_buffers(&ring) < 0) {
+        const int saved = errno;
+        ht_uring_free(&ring);
+        errno = saved;
+        return -1;
+    }
+    for (int i = 0; i < server->num_listeners; i++) {
+        ht_uring_accept(&ring, &server->listeners[i]);
+    }
+    ht_uring_wake(&ring);
+    int result = 0;
+    while (!server->stopping) {
+        if (ht_uring_enter(&ring, 1) < 0) {
+            result = -1;
+            break;
+        }
+        ht_conn* dirty = NULL;
+        unsigned head = *ring.cq_head;
+        const unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe* cqe = &ring.cqes[head & ring.cq_mask];
+            const int kind = (int)(cqe->user_data & HT_URING_KIND_MASK);
+            void* owner = (void*)(uintptr_t)(cqe->user_data & ~HT_URING_KIND_MASK);
+            const int more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+            if (kind == HT_URING_ACCEPT) {
+                ht_listener* listener = owner;
+                if (cqe->res >= 0) {
+                    ht_uring_recv(&ring, ht_conn_new(server, cqe->res, listener->protocol));
+                }
+                if (!more) {
+                    const int starved = cqe->res == -EMFILE || cqe->res == -ENFILE || cqe->res == -ENOBUFS ||
+                                        cqe->res == -ENOMEM;
+                    if (starved) {
+                        ht_uring_retry_accept(&ring, listener);
+                    } else {
+                        ht_uring_accept(&ring, listener);
+                    }
+                }
+            } else if (kind == HT_URING_RECV) {
+                ht_conn* conn = owner;
+                if (!more) {
+                    conn->inflight--;
+                    conn->receiving = 0;
+                }
+                int failed = cqe->res <= 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED;
+                if (cqe->flags & IORING_CQE_F_BUFFER) {
+                    const unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+                    if (cqe->res > 0 && !conn->closing) {
+                        failed = ht_uring_received(&ring, conn, ring.bufs + (size_t)bid * HT_URING_BUF_SIZE,
+                                                   (size_t)cqe->res) < 0;
+                    }
+                    ht_uring_recycle(&ring, bid);
+                }
+                if (failed || conn->closing) {
+                    ht_uring_close(&ring, conn);
+                    continue;
+                }
+                if (!more && !conn->throttled) {
+                    ht_uring_recv(&ring, conn); //ran out of buffers or the kernel ended the multishot, rearm
+                }
+                if (conn->out.len > conn->out_sent) {
+                    ht_uring_mark_dirty(&dirty, conn);
+                }
+            } else if (kind == HT_URING_SEND) {
+                ht_conn* conn = owner;
+                conn->inflight--;
+                conn->sending = 0;
+                if (cqe->res < 0 || conn->closing) {
+                    ht_uring_close(&ring, conn);
+                    continue;
+                }
+                if (ht_uring_sent(&ring, conn, (size_t)cqe->res) < 0) {
+                    ht_uring_close(&ring, conn);
+                    continue;
+                }
+                if (conn->out.len > conn->out_sent) {
+                    ht_uring_mark_dirty(&dirty, conn);
+                }
+            } else if (kind == HT_URING_CANCEL) {
+                ht_conn* conn = owner;
+                conn->inflight--;
+                if (conn->closing) {
+                    ht_uring_close(&ring, conn);
+                }
+            } else if (kind == HT_URING_RETRY) {
+                ht_uring_accept(&ring, owner);
+            } else if (kind == HT_URING_WAKE) {
+                if (!server->stopping) {
+                    ht_uring_wake(&ring);
+                }
+            }
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+        //one send per connection for everything this batch produced, submitted with the next wait
+        while (dirty != NULL) {
+            ht_conn* conn = dirty;
+            dirty = conn->dirty;
+            conn->queued = 0;
+            if (conn->closing) {
+                ht_uring_close(&ring, conn);
+            } else if (!conn->sending && conn->out.len > conn->out_sent) {
+                ht_uring_send(&ring, conn);
+            }
+        }
+    }
+    //closing the ring cancels the accepts, recvs and sends still pending, after that nothing refers to a connection
+    ht_uring_free(&ring);
+    while (server->conns != NULL) {
+        ht_conn_free(server, server->conns);
+    }
+    return result;
+}
+
+#else
+
+int ht_server_run_uring(ht_server* server) {
+    (void)server;
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
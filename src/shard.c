@@ -0,0 +1,816 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#define _GNU_SOURCE //accept4, pthread_setaffinity_np
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "hash_table_internal.h"
+#include "server_internal.h"
+#include "shard.h"
+#include "siphash.h"
+
+#define HT_SHARD_RING 1024 //messages in flight from one core to another, more wait in the sender's outbox
+#define HT_SHARD_MAX_WAITING 4096 //requests a connection may have out at other cores before its input stops being read
+#define HT_SHARD_EVENTS 256 //epoll events taken per wait
+#define HT_SHARD_ACCEPT_RETRY_MS 100 //longest core 0 sleeps while the listener is paused for want of file descriptors
+#define HT_SHARD_ADOPT 0xff //message op handing a newly accepted socket to the core that will serve it
+
+typedef struct ht_shard_conn ht_shard_conn;
+
+//a request on its way to the core owning its key, then the response on its way back
+typedef struct ht_shard_msg {
+    struct ht_shard_msg* order; //the connection's next request, responses are written in this order
+    struct ht_shard_msg* next; //next message in the same outbox
+    ht_shard_conn* conn;
+    int origin; //core serving the connection
+    int done; //set by the origin once the response is in, the message then belongs to the connection
+    int fd; //HT_SHARD_ADOPT only
+    uint8_t op; //HT_OP_* or HT_SHARD_ADOPT
+    uint8_t status;
+    uint32_t value_len;
+    char* value; //SET: the value to store, GET: a copy of the value found
+    char key[];
+} ht_shard_msg;
+
+struct ht_shard_conn {
+    ht_endpoint endpoint;
+    ht_shard_conn* prev; //every connection not freed yet is on its core's list
+    ht_shard_conn* next;
+    ht_buf in;
+    ht_buf out;
+    size_t out_sent; //bytes at the start of out already written
+    int want_write; //EPOLLOUT is in the interest set
+    int throttled; //input left unread for too much pending output or too many requests out at other cores
+    int closed; //socket closed, the connection is kept until its requests out at other cores come back
+    int waiting; //requests out at other cores
+    ht_shard_msg* first; //requests whose responses have not been written yet, oldest first
+    ht_shard_msg* last;
+    ht_shard_conn* dirty; //next connection with output to send at the end of the loop iteration
+    int queued; //on the dirty list
+};
+
+//Single producer, single consumer ring. Each side's index is on its own cache line next to a cached copy of the
+//other side's, so the line the other core writes is only read when the ring looks full or empty.
+typedef struct {
+    _Alignas(HT_CACHE_LINE) size_t head; //next slot to pop, written by the consumer
+    size_t tail_cache;
+    _Alignas(HT_CACHE_LINE) size_t tail; //next slot to push, written by the producer
+    size_t head_cache;
+    _Alignas(HT_CACHE_LINE) ht_shard_msg* slots[HT_SHARD_RING];
+} ht_spsc;
+
+typedef struct {
+    _Alignas(HT_CACHE_LINE) int sleeping; //blocked in epoll_wait, a core sending to it must write its eventfd
+    _Alignas(HT_CACHE_LINE) ht_shard_server* server;
+    int index;
+    int cpu; //the CPU the core's thread is pinned to
+    ht_hash_table* ht; //the shard, only ever touched by this core's thread
+    int epoll_fd;
+    ht_endpoint wake;
+    pthread_t thread;
+    int failed; //epoll_wait failed, the loop stopped
+    ht_shard_conn* conns;
+    ht_shard_conn* dirty;
+    ht_shard_msg** outbox_first; //per destination core, messages its ring had no room for yet
+    ht_shard_msg** outbox_last;
+    int pending; //some outbox is not empty
+    int next_core; //core 0 only, where the next accepted connection goes
+} ht_shard_core;
+
+struct ht_shard_server {
+    int cores;
+    ht_shard_core* core;
+    ht_spsc* rings; //rings[from * cores + to]
+    ht_endpoint listener; //watched by core 0 only
+    int listener_paused; //out of core 0's epoll set while accept has no file descriptor to give a connection
+    char path[sizeof(((struct sockaddr_un*)NULL)->sun_path)];
+    uint64_t seed[2]; //keys the routing hash, so clients cannot choose keys that all land on one core
+    int stopping; //set by ht_shard_server_stop from any thread, read with atomics
+};
+
+static int ht_spsc_push(ht_spsc* ring, ht_shard_msg* msg) {
+    const size_t tail = ring->tail;
+    if (tail - ring->head_cache == HT_SHARD_RING) {
+        ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail - ring->head_cache == HT_SHARD_RING) {
+            return 0;
+        }
+    }
+    ring->slots[tail % HT_SHARD_RING] = msg;
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static ht_shard_msg* ht_spsc_pop(ht_spsc* ring) {
+    const size_t head = ring->head;
+    if (head == ring->tail_cache) {
+        ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head == ring->tail_cache) {
+            return NULL;
+        }
+    }
+    ht_shard_msg* msg = ring->slots[head % HT_SHARD_RING];
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return msg;
+}
+
+//the core that owns key
+static int ht_shard_owner(const ht_shard_server* server, const char* key, const size_t len) {
+    if (server->cores == 1) {
+        return 0;
+    }
+    return (int)((siphash13(key, len, server->seed) >> 32) * (uint64_t)server->cores >> 32);
+}
+
+static void ht_shard_msg_free(ht_shard_msg* msg) {
+    free(msg->value);
+    free(msg);
+}
+
+//ht_upsert callback of SET, the value was copied into the message by the core that received it
+static char* ht_shard_take(const char* key, char* current, void* ctx) {
+    (void)key;
+    (void)current;
+    return ctx;
+}
+
+//runs a request against the shard of the core it was sent to, leaving the response in the message
+static void ht_shard_execute(ht_hash_table* ht, ht_shard_msg* msg) {
+    if (msg->op == HT_OP_GET) {
+        const char* value = ht_search(ht, msg->key);
+        msg->status = value != NULL ? HT_STATUS_OK : HT_STATUS_NOT_FOUND;
+        if (value != NULL) {
+            //copied, the owner may replace or delete the value before the response is written
+            msg->value_len = (uint32_t)strlen(value);
+            msg->value = ht_malloc(msg->value_len);
+            memcpy(msg->value, value, msg->value_len);
+        }
+    } else if (msg->op == HT_OP_SET) {
+        ht_upsert(ht, msg->key, ht_shard_take, msg->value);
+        msg->value = NULL;
+        msg->value_len = 0;
+        msg->status = HT_STATUS_OK;
+    } else if (msg->op == HT_OP_DEL) {
+        msg->status = ht_delete(ht, msg->key) ? HT_STATUS_OK : HT_STATUS_NOT_FOUND;
+    } else {
+        msg->status = HT_STATUS_ERROR;
+    }
+}
+
+//queues msg for core to, it goes onto the ring at the end of the loop iteration
+static void ht_shard_post(ht_shard_core* core, const int to, ht_shard_msg* msg) {
+    msg->next = NULL;
+    if (core->outbox_first[to] == NULL) {
+        core->outbox_first[to] = msg;
+    } else {
+        core->outbox_last[to]->next = msg;
+    }
+    core->outbox_last[to] = msg;
+    core->pending = 1;
+}
+
+static void ht_shard_wake(ht_shard_core* core) {
+    if (__atomic_load_n(&core->sleeping, __ATOMIC_SEQ_CST) && __atomic_exchange_n(&core->sleeping, 0, __ATOMIC_SEQ_CST)) {
+        const uint64_t one = 1;
+        ssize_t ignored = write(core->wake.fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+//moves the outboxes onto the rings, as much as they have room for, and wakes the cores that were sent anything
+static void ht_shard_send(ht_shard_core* core) {
+    ht_shard_server* server = core->server;
+    core->pending = 0;
+    for (int to = 0; to < server->cores; to++) {
+        ht_shard_msg* msg = core->outbox_first[to];
+        if (msg == NULL) {
+            continue;
+        }
+        ht_spsc* ring = &server->rings[core->index * server->cores + to];
+        int sent = 0;
+        while (msg != NULL) {
+            ht_shard_msg* next = msg->next; //once pushed the message is the other core's, next included
+            if (!ht_spsc_push(ring, msg)) {
+                break;
+            }
+            msg = next;
+            sent = 1;
+        }
+        core->outbox_first[to] = msg;
+        core->pending |= msg != NULL;
+        if (sent) {
+            //pairs with the fence between the receiver setting sleeping and checking its rings
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            ht_shard_wake(&server->core[to]);
+        }
+    }
+}
+
+//some other core has sent this one messages it has not taken yet
+static int ht_shard_has_input(ht_shard_core* core) {
+    ht_shard_server* server = core->server;
+    for (int from = 0; from < server->cores; from++) {
+        ht_spsc* ring = &server->rings[from * server->cores + core->index];
+        if (from != core->index && __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != ring->head) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void ht_shard_conn_free(ht_shard_core* core, ht_shard_conn* conn) {
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        core->conns = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    }
+    ht_buf_free(&conn->in);
+    ht_buf_free(&conn->out);
+    free(conn);
+}
+
+//Closes the socket. Responses already in are dropped now, the rest as they come back, and the connection itself
+//is freed once nothing of it is left at another core.
+static void ht_shard_close(ht_shard_core* core, ht_shard_conn* conn) {
+    close(conn->endpoint.fd);
+    conn->closed = 1;
+    ht_shard_msg* msg = conn->first;
+    while (msg != NULL) {
+        ht_shard_msg* next = msg->order;
+        if (msg->done) {
+            ht_shard_msg_free(msg);
+        }
+        msg = next;
+    }
+    conn->first = NULL;
+    conn->last = NULL;
+    if (conn->waiting == 0 && !conn->queued) {
+        ht_shard_conn_free(core, conn);
+    }
+}
+
+static void ht_shard_mark_dirty(ht_shard_core* core, ht_shard_conn* conn) {
+    if (!conn->queued && !conn->closed) {
+        conn->queued = 1;
+        conn->dirty = core->dirty;
+        core->dirty = conn;
+    }
+}
+
+//takes a newly accepted socket on as one of this core's connections
+static void ht_shard_adopt(ht_shard_core* core, const int fd) {
+    ht_shard_conn* conn = ht_calloc(1, sizeof(ht_shard_conn));
+    conn->endpoint.kind = HT_ENDPOINT_CONN;
+    conn->endpoint.fd = fd;
+    conn->next = core->conns;
+    if (conn->next != NULL) {
+        conn->next->prev = conn;
+    }
+    core->conns = conn;
+    //edge triggered, input that arrived while the socket was being handed over is reported by the add itself
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLET, .data.ptr = conn};
+    if (epoll_ctl(core->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd); //never to be woken for, it would sit open forever
+        ht_shard_conn_free(core, conn);
+    }
+}
+
+//Core 0 takes the listener out of its epoll set. The pending connection stays in the backlog, so the level triggered
+//listener would otherwise wake every wait for a connection accept cannot take.
+static void ht_shard_pause_listener(ht_shard_core* core) {
+    ht_shard_server* server = core->server;
+    if (!server->listener_paused && epoll_ctl(core->epoll_fd, EPOLL_CTL_DEL, server->listener.fd, NULL) == 0) {
+        server->listener_paused = 1;
+    }
+}
+
+//puts the listener back once core 0 comes back from a wait with nothing to do, if epoll still refuses the next one
+//tries again
+static void ht_shard_resume_listener(ht_shard_core* core) {
+    ht_shard_server* server = core->server;
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &server->listener};
+    if (epoll_ctl(core->epoll_fd, EPOLL_CTL_ADD, server->listener.fd, &ev) == 0) {
+        server->listener_paused = 0;
+    }
+}
+
+static void ht_shard_accept(ht_shard_core* core) {
+    ht_shard_server* server = core->server;
+    for (;;) {
+        const int fd = accept4(server->listener.fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                ht_shard_pause_listener(core);
+            }
+            return; //EAGAIN once the backlog is empty, anything else is the client's problem
+        }
+        const int to = core->next_core;
+        core->next_core = (to + 1) % server->cores;
+        if (to == core->index) {
+            ht_shard_adopt(core, fd);
+            continue;
+        }
+        ht_shard_msg* msg = ht_calloc(1, sizeof(ht_shard_msg));
+        msg->op = HT_SHARD_ADOPT;
+        msg->fd = fd;
+        msg->origin = core->index;
+        ht_shard_post(core, to, msg);
+    }
+}
+
+//Executes every complete request in the connection's input whose key this core owns and whose response can be
+//written straight away, and turns the rest into messages. Returns the bytes consumed or -1 on a malformed stream.
+static long ht_shard_route(ht_shard_core* core, ht_shard_conn* conn) {
+    const char* in = conn->in.data;
+    const size_t len = conn->in.len;
+    char key[HT_SERVER_MAX_KEY + 1];
+    size_t off = 0;
+    while (len - off >= sizeof(ht_request_header)) {
+        ht_request_header header;
+        memcpy(&header, in + off, sizeof(header));
+        if (header.key_len == 0 || header.key_len > HT_SERVER_MAX_KEY || header.value_len > HT_SERVER_MAX_VALUE) {
+            return -1;
+        }
+        const size_t total = sizeof(header) + header.key_len + header.value_len;
+        if (len - off < total) {
+            break;
+        }
+        const char* k = in + off + sizeof(header);
+        const char* v = k + header.key_len;
+        off += total;
+        const int valid = memchr(k, '\0', header.key_len) == NULL && memchr(v, '\0', header.value_len) == NULL;
+        const int owner = valid ? ht_shard_owner(core->server, k, header.key_len) : core->index;
+        if (owner == core->index && conn->first == NULL) {
+            //nothing before it is still waiting on another core, so it is answered in place
+            if (!valid) {
+                ht_binary_respond(&conn->out, HT_STATUS_ERROR, NULL, 0);
+                continue;
+            }
+            memcpy(key, k, header.key_len);
+            key[header.key_len] = '\0';
+            ht_binary_execute(core->ht, header.op, key, v, header.value_len, &conn->out);
+            continue;
+        }
+        ht_shard_msg* msg = ht_malloc(sizeof(ht_shard_msg) + header.key_len + 1);
+        msg->order = NULL;
+        msg->conn = conn;
+        msg->origin = core->index;
+        msg->done = 0;
+        msg->op = header.op;
+        msg->status = HT_STATUS_ERROR;
+        msg->value = NULL;
+        msg->value_len = 0;
+        memcpy(msg->key, k, header.key_len);
+        msg->key[header.key_len] = '\0';
+        if (valid && header.op == HT_OP_SET) {
+            msg->value = ht_malloc((size_t)header.value_len + 1);
+            memcpy(msg->value, v, header.value_len);
+            msg->value[header.value_len] = '\0';
+        }
+        if (conn->last == NULL) {
+            conn->first = msg;
+        } else {
+            conn->last->order = msg;
+        }
+        conn->last = msg;
+        if (owner != core->index) {
+            conn->waiting++;
+            ht_shard_post(core, owner, msg);
+            continue;
+        }
+        if (valid) {
+            ht_shard_execute(core->ht, msg);
+        }
+        msg->done = 1;
+    }
+    return (long)off;
+}
+
+//Reads until the socket is drained or the connection has too much outstanding, routing the requests after every
+//read. Returns -1 once the connection is finished with.
+static int ht_shard_read(ht_shard_core* core, ht_shard_conn* conn) {
+    conn->throttled = 0;
+    for (;;) {
+        if (conn->out.len - conn->out_sent >= HT_SERVER_MAX_PENDING || conn->waiting >= HT_SHARD_MAX_WAITING) {
+            conn->throttled = 1;
+            return 0;
+        }
+        ht_buf_reserve(&conn->in, HT_SERVER_READ_SIZE);
+        const ssize_t n = recv(conn->endpoint.fd, conn->in.data + conn->in.len, conn->in.cap - conn->in.len, 0);
+        if (n == 0) {
+            return -1;
+        }
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        conn->in.len += (size_t)n;
+        const long used = ht_shard_route(core, conn);
+        if (used < 0) {
+            return -1;
+        }
+        ht_buf_consume(&conn->in, (size_t)used);
+    }
+}
+
+//returns -1 if epoll would not change what the connection is watched for
+static int ht_shard_watch(ht_shard_core* core, ht_shard_conn* conn, const int want_write) {
+    if (conn->want_write == want_write) {
+        return 0;
+    }
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLET | (want_write ? EPOLLOUT : 0), .data.ptr = conn};
+    if (epoll_ctl(core->epoll_fd, EPOLL_CTL_MOD, conn->endpoint.fd, &ev) < 0) {
+        return -1;
+    }
+    conn->want_write = want_write;
+    return 0;
+}
+
+//writes as much queued output as the socket takes, returns -1 if the connection broke
+static int ht_shard_flush(ht_shard_core* core, ht_shard_conn* conn) {
+    while (conn->out_sent < conn->out.len) {
+        const ssize_t n = send(conn->endpoint.fd, conn->out.data + conn->out_sent, conn->out.len - conn->out_sent,
+                               MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return ht_shard_watch(core, conn, 1);
+            }
+            return -1;
+        }
+        conn->out_sent += (size_t)n;
+    }
+    conn->out.len = 0;
+    conn->out_sent = 0;
+    return ht_shard_watch(core, conn, 0);
+}
+
+//Writes the responses that are next in order, and goes back to reading input left behind by throttling once the
+//connection has caught up. Returns -1 once the connection is finished with.
+static int ht_shard_pump(ht_shard_core* core, ht_shard_conn* conn) {
+    for (;;) {
+        while (conn->first != NULL && conn->first->done) {
+            ht_shard_msg* msg = conn->first;
+            ht_binary_respond(&conn->out, msg->status, msg->value, msg->value_len);
+            conn->first = msg->order;
+            ht_shard_msg_free(msg);
+        }
+        if (conn->first == NULL) {
+            conn->last = NULL;
+        }
+        if (ht_shard_flush(core, conn) < 0) {
+            return -1;
+        }
+        //edge triggered: input left behind by throttling is not signalled again, so go back for it ourselves
+        if (!conn->throttled || conn->out.len > 0 || conn->waiting >= HT_SHARD_MAX_WAITING) {
+            return 0;
+        }
+        if (ht_shard_read(core, conn) < 0) {
+            return -1;
+        }
+    }
+}
+
+//a response has come back from the core that owns the key
+static void ht_shard_complete(ht_shard_core* core, ht_shard_msg* msg) {
+    ht_shard_conn* conn = msg->conn;
+    conn->waiting--;
+    if (conn->closed) {
+        ht_shard_msg_free(msg);
+        if (conn->waiting == 0 && !conn->queued) {
+            ht_shard_conn_free(core, conn);
+        }
+        return;
+    }
+    msg->done = 1;
+    ht_shard_mark_dirty(core, conn);
+}
+
+//takes what the other cores have sent this one, at most a ring's worth from each so none can keep it busy forever
+static void ht_shard_drain(ht_shard_core* core) {
+    ht_shard_server* server = core->server;
+    for (int from = 0; from < server->cores; from++) {
+        if (from == core->index) {
+            continue;
+        }
+        ht_spsc* ring = &server->rings[from * server->cores + core->index];
+        ht_shard_msg* msg;
+        for (int i = 0; i < HT_SHARD_RING && (msg = ht_spsc_pop(ring)) != NULL; i++) {
+            if (msg->op == HT_SHARD_ADOPT) {
+                ht_shard_adopt(core, msg->fd);
+                free(msg);
+            } else if (msg->origin == core->index) {
+                ht_shard_complete(core, msg);
+            } else {
+                ht_shard_execute(core->ht, msg);
+                ht_shard_post(core, msg->origin, msg);
+            }
+        }
+    }
+}
+
+static void ht_shard_flush_dirty(ht_shard_core* core) {
+    while (core->dirty != NULL) {
+        ht_shard_conn* conn = core->dirty;
+        core->dirty = conn->dirty;
+        conn->queued = 0;
+        if (conn->closed) {
+            if (conn->waiting == 0) {
+                ht_shard_conn_free(core, conn);
+            }
+        } else if (ht_shard_pump(core, conn) < 0) {
+            ht_shard_close(core, conn);
+        }
+    }
+}
+
+static void* ht_shard_core_main(void* arg) {
+    ht_shard_core* core = arg;
+    ht_shard_server* server = core->server;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core->cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set); //best effort
+    //created by its own thread, so on a NUMA machine the shard's memory comes from the node it is served from
+    if (core->ht == NULL) {
+        core->ht = ht_new_seeded();
+    }
+    struct epoll_event events[HT_SHARD_EVENTS];
+    while (!__atomic_load_n(&server->stopping, __ATOMIC_ACQUIRE)) {
+        int timeout = core->pending ? 0 : -1;
+        if (timeout < 0) {
+            __atomic_store_n(&core->sleeping, 1, __ATOMIC_SEQ_CST);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (ht_shard_has_input(core)) {
+                timeout = 0;
+            } else if (server->listener_paused && core->index == 0) {
+                timeout = HT_SHARD_ACCEPT_RETRY_MS;
+            }
+        }
+        const int n = epoll_wait(core->epoll_fd, events, HT_SHARD_EVENTS, timeout);
+        __atomic_store_n(&core->sleeping, 0, __ATOMIC_SEQ_CST);
+        if (n < 0 && errno != EINTR) {
+            core->failed = 1;
+            ht_shard_server_stop(server);
+            break;
+        }
+        if (n == 0 && server->listener_paused && core->index == 0) {
+            ht_shard_resume_listener(core);
+        }
+        for (int i = 0; i < n; i++) {
+            ht_endpoint* endpoint = events[i].data.ptr;
+            if (endpoint->kind == HT_ENDPOINT_LISTENER) {
+                ht_shard_accept(core);
+                continue;
+            }
+            if (endpoint->kind == HT_ENDPOINT_WAKE) {
+                uint64_t count;
+                ssize_t ignored = read(core->wake.fd, &count, sizeof(count));
+                (void)ignored;
+                continue;
+            }
+            ht_shard_conn* conn = (ht_shard_conn*)endpoint;
+            if (conn->closed) {
+                continue;
+            }
+            if ((events[i].events & (EPOLLERR | EPOLLHUP)) ||
+                ((events[i].events & EPOLLIN) && ht_shard_read(core, conn) < 0)) {
+                ht_shard_close(core, conn);
+                continue;
+            }
+            ht_shard_mark_dirty(core, conn);
+        }
+        ht_shard_drain(core);
+        ht_shard_flush_dirty(core);
+        ht_shard_send(core);
+    }
+    return NULL;
+}
+
+//Every thread has stopped: the connections are freed, then the messages still on the rings or in the outboxes,
+//which include the requests the connections were waiting on.
+static void ht_shard_shutdown(ht_shard_server* server) {
+    for (int c = 0; c < server->cores; c++) {
+        ht_shard_core* core = &server->core[c];
+        core->dirty = NULL;
+        while (core->conns != NULL) {
+            ht_shard_conn* conn = core->conns;
+            conn->waiting = 0;
+            conn->queued = 0;
+            if (conn->closed) {
+                ht_shard_conn_free(core, conn);
+            } else {
+                ht_shard_close(core, conn);
+            }
+        }
+    }
+    for (int i = 0; i < server->cores * server->cores; i++) {
+        ht_shard_msg* msg;
+        while ((msg = ht_spsc_pop(&server->rings[i])) != NULL) {
+            if (msg->op == HT_SHARD_ADOPT) {
+                close(msg->fd);
+            }
+            ht_shard_msg_free(msg);
+        }
+    }
+    for (int c = 0; c < server->cores; c++) {
+        ht_shard_core* core = &server->core[c];
+        for (int to = 0; to < server->cores; to++) {
+            while (core->outbox_first[to] != NULL) {
+                ht_shard_msg* msg = core->outbox_first[to];
+                core->outbox_first[to] = msg->next;
+                if (msg->op == HT_SHARD_ADOPT) {
+                    close(msg->fd);
+                }
+                ht_shard_msg_free(msg);
+            }
+        }
+        core->pending = 0;
+    }
+}
+
+ht_shard_server* ht_shard_server_new(int cores) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) < 0) {
+        CPU_ZERO(&allowed);
+        CPU_SET(0, &allowed);
+    }
+    if (cores <= 0) {
+        cores = CPU_COUNT(&allowed);
+    }
+    ht_shard_server* server = ht_calloc(1, sizeof(ht_shard_server));
+    server->cores = cores;
+    server->listener.kind = HT_ENDPOINT_LISTENER;
+    server->listener.fd = -1;
+    ht_random_seed(server->seed);
+    server->core = ht_aligned_alloc(HT_CACHE_LINE, sizeof(ht_shard_core) * (size_t)cores);
+    memset(server->core, 0, sizeof(ht_shard_core) * (size_t)cores);
+    server->rings = ht_aligned_alloc(HT_CACHE_LINE, sizeof(ht_spsc) * (size_t)cores * (size_t)cores);
+    memset(server->rings, 0, sizeof(ht_spsc) * (size_t)cores * (size_t)cores);
+    int cpu = -1;
+    for (int i = 0; i < cores; i++) {
+        ht_shard_core* core = &server->core[i];
+        core->server = server;
+        core->index = i;
+        //the allowed CPUs in turn, wrapping round when there are more cores than CPUs
+        do {
+            cpu = (cpu + 1) % CPU_SETSIZE;
+        } while (!CPU_ISSET(cpu, &allowed));
+        core->cpu = cpu;
+        core->outbox_first = ht_calloc((size_t)cores, sizeof(ht_shard_msg*));
+        core->outbox_last = ht_calloc((size_t)cores, sizeof(ht_shard_msg*));
+        core->wake.kind = HT_ENDPOINT_WAKE;
+        core->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        core->wake.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (core->epoll_fd < 0 || core->wake.fd < 0) {
+            server->cores = i + 1;
+            ht_shard_server_free(server);
+            return NULL;
+        }
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &core->wake};
+        if (epoll_ctl(core->epoll_fd, EPOLL_CTL_ADD, core->wake.fd, &ev) < 0) {
+            server->cores = i + 1;
+            ht_shard_server_free(server);
+            return NULL;
+        }
+    }
+    return server;
+}
+
+//Closes the listening socket and removes its socket file, and frees every core's shard.
+void ht_shard_server_free(ht_shard_server* server) {
+    if (server->listener.fd >= 0) {
+        close(server->listener.fd);
+        unlink(server->path);
+    }
+    for (int i = 0; i < server->cores; i++) {
+        ht_shard_core* core = &server->core[i];
+        if (core->ht != NULL) {
+            ht_delete_hash_table(core->ht);
+        }
+        if (core->wake.fd >= 0) {
+            close(core->wake.fd);
+        }
+        if (core->epoll_fd >= 0) {
+            close(core->epoll_fd);
+        }
+        free(core->outbox_first);
+        free(core->outbox_last);
+    }
+    free(server->core);
+    free(server->rings);
+    free(server);
+}
+
+int ht_shard_server_cores(const ht_shard_server* server) {
+    return server->cores;
+}
+
+//Listens on a Unix domain socket at path, replacing a stale socket file left there. One listener per server.
+//Returns 0, or -1 with errno set.
+int ht_shard_server_listen_unix(ht_shard_server* server, const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (server->listener.fd >= 0 || strlen(path) >= sizeof(addr.sun_path)) {
+        errno = EINVAL;
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        const int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &server->listener};
+    if (epoll_ctl(server->core[0].epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        const int saved = errno;
+        close(fd);
+        unlink(path);
+        errno = saved;
+        return -1;
+    }
+    server->listener.fd = fd;
+    strcpy(server->path, path);
+    return 0;
+}
+
+//Serves until ht_shard_server_stop is called, the calling thread becoming core 0 (and pinned like the others).
+//Connections still open are closed before it returns. Returns 0, or -1 with errno set if a thread could not be
+//started or a core's epoll_wait failed.
+int ht_shard_server_run(ht_shard_server* server) {
+    int started = 1;
+    int result = 0;
+    for (; started < server->cores; started++) {
+        ht_shard_core* core = &server->core[started];
+        const int err = pthread_create(&core->thread, NULL, ht_shard_core_main, core);
+        if (err != 0) {
+            ht_shard_server_stop(server);
+            errno = err;
+            result = -1;
+            break;
+        }
+    }
+    if (result == 0) {
+        ht_shard_core_main(&server->core[0]);
+    }
+    for (int i = 1; i < started; i++) {
+        pthread_join(server->core[i].thread, NULL);
+    }
+    ht_shard_shutdown(server);
+    for (int i = 0; i < server->cores; i++) {
+        if (server->core[i].failed) {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+//Makes ht_shard_server_run return, safe to call from a signal handler or another thread.
+void ht_shard_server_stop(ht_shard_server* server) {
+    __atomic_store_n(&server->stopping, 1, __ATOMIC_RELEASE);
+    const uint64_t one = 1;
+    for (int i = 0; i < server->cores; i++) {
+        ssize_t ignored = write(server->core[i].wake.fd, &one, sizeof(one));
+        (void)ignored;
+    }
+}
@@ -0,0 +1,45 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#ifndef SHARD_H
+#define SHARD_H
+
+//Thread-per-core, shared-nothing variant of ht_server: one thread pinned to each core, each owning its own
+//ht_hash_table shard that no other thread ever touches, so the hot path takes no locks.
+//
+//A key belongs to the core its keyed hash picks. Connections are handed out round robin by core 0, which accepts
+//them, and the core serving a connection executes requests for its own keys straight away and passes the rest to
+//their owner as messages on single producer, single consumer rings, one ring per ordered pair of cores. The owner
+//executes the request against its shard and passes the message back on its ring to the requesting core, which puts
+//the responses back in request order before writing them. Messages are moved in batches, and a core is woken
+//through its eventfd only when it has gone to sleep with nothing to do.
+//
+//Speaks the pipelined binary protocol of server.h over a Unix domain socket.
+
+#include "server.h"
+
+typedef struct ht_shard_server ht_shard_server;
+
+//cores <= 0 uses one per online CPU
+ht_shard_server* ht_shard_server_new(int cores);
+void ht_shard_server_free(ht_shard_server* server);
+int ht_shard_server_cores(const ht_shard_server* server);
+int ht_shard_server_listen_unix(ht_shard_server* server, const char* path);
+int ht_shard_server_run(ht_shard_server* server);
+void ht_shard_server_stop(ht_shard_server* server);
+
+#endif
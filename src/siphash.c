@@ -0,0 +1,75 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#include "siphash.h"
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+//one SipRound, mixes the four words of state
+#define SIPROUND(v0, v1, v2, v3) do { \
+        v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+        v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2; \
+        v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0; \
+        v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32); \
+    } while (0)
+
+//reads 8 bytes little endian regardless of the host's byte order or the pointer's alignment
+static uint64_t load_le64(const unsigned char* p) {
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+/*
+ * SipHash with 1 compression round per 8 byte block and 3 finalization rounds.
+ * This is the variant Rust and Python use for their hash tables: still keyed, about twice as fast as SipHash-2-4.
+ */
+uint64_t siphash13(const void* data, const size_t len, const uint64_t key[2]) {
+    const unsigned char* in = data;
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+
+    const unsigned char* end = in + (len & ~(size_t)7);
+    for (; in != end; in += 8) {
+        const uint64_t m = load_le64(in);
+        v3 ^= m;
+        SIPROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    //the last block holds the remaining 0-7 bytes with the length in the top byte
+    uint64_t b = (uint64_t)len << 56;
+    switch (len & 7) {
+        case 7: b |= (uint64_t)in[6] << 48; /* fall through */
+        case 6: b |= (uint64_t)in[5] << 40; /* fall through */
+        case 5: b |= (uint64_t)in[4] << 32; /* fall through */
+        case 4: b |= (uint64_t)in[3] << 24; /* fall through */
+        case 3: b |= (uint64_t)in[2] << 16; /* fall through */
+        case 2: b |= (uint64_t)in[1] << 8; /* fall through */
+        case 1: b |= (uint64_t)in[0]; break;
+        case 0: break;
+    }
+    v3 ^= b;
+    SIPROUND(v0, v1, v2, v3);
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -0,0 +1,353 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_table_internal.h"
+#include "sketch.h"
+
+#define HT_FREQ_BLOCK_WORDS 8 //one 64 byte cache line
+#define HT_FREQ_DEPTH 4
+#define HT_FREQ_MAX 15
+#define HT_COUNT_BLOCK 16 //32 bit counters in one 64 byte cache line
+#define HT_COUNT_DEPTH 4
+#define HT_BLOOM_BLOCK_WORDS 8 //256 bits, aligned so a block never straddles two cache lines
+#define HT_BLOOM_BITS_PER_KEY 12
+
+//sizes the sketch for about capacity distinct hot keys: one word, so 16 counters, per key rounded up to a power of two
+void ht_freq_init(ht_freq_sketch* sketch, const size_t capacity) {
+    size_t words = HT_FREQ_BLOCK_WORDS;
+    while (words < capacity) {
+        words <<= 1;
+    }
+    sketch->table = ht_aligned_alloc(64, words * sizeof(uint64_t));
+    memset(sketch->table, 0, words * sizeof(uint64_t));
+    sketch->block_mask = words / HT_FREQ_BLOCK_WORDS - 1;
+    sketch->additions = 0;
+    sketch->sample_size = (capacity > 0 ? capacity : 1) * 10;
+}
+
+void ht_freq_free(ht_freq_sketch* sketch) {
+    free(sketch->table);
+    sketch->table = NULL;
+}
+
+//the low bits pick the block, then each depth takes 3 bits for its word and 4 bits for the counter inside it
+static uint64_t* ht_freq_block(const ht_freq_sketch* sketch, const uint64_t h) {
+    return sketch->table + (h & sketch->block_mask) * HT_FREQ_BLOCK_WORDS;
+}
+
+static int ht_freq_word(const uint64_t h, const int depth) {
+    return (int)((h >> (32 + depth * 3)) & (HT_FREQ_BLOCK_WORDS - 1));
+}
+
+static int ht_freq_shift(const uint64_t h, const int depth) {
+    return (int)((h >> (48 + depth * 4)) & 15) * 4;
+}
+
+//halves every counter, 4 bit fields shift right together once the bits crossing into the next field are masked off
+static void ht_freq_age(ht_freq_sketch* sketch) {
+    const size_t words = (sketch->block_mask + 1) * HT_FREQ_BLOCK_WORDS;
+    for (size_t i = 0; i < words; i++) {
+        sketch->table[i] = (sketch->table[i] >> 1) & 0x7777777777777777ULL;
+    }
+    sketch->additions /= 2;
+}
+
+void ht_freq_increment(ht_freq_sketch* sketch, const uint64_t hash) {
+    const uint64_t h = ht_sketch_mix(hash);
+    uint64_t* block = ht_freq_block(sketch, h);
+    for (int d = 0; d < HT_FREQ_DEPTH; d++) {
+        uint64_t* word = &block[ht_freq_word(h, d)];
+        const int shift = ht_freq_shift(h, d);
+        if (((*word >> shift) & 15) < HT_FREQ_MAX) {
+            *word += 1ULL << shift;
+        }
+    }
+    if (++sketch->additions >= sketch->sample_size) {
+        ht_freq_age(sketch);
+    }
+}
+
+//the smallest of the key's counters, collisions can only push the others up
+int ht_freq_estimate(const ht_freq_sketch* sketch, const uint64_t hash) {
+    const uint64_t h = ht_sketch_mix(hash);
+    const uint64_t* block = ht_freq_block(sketch, h);
+    int estimate = HT_FREQ_MAX;
+    for (int d = 0; d < HT_FREQ_DEPTH; d++) {
+        const int count = (int)((block[ht_freq_word(h, d)] >> ht_freq_shift(h, d)) & 15);
+        if (count < estimate) {
+            estimate = count;
+        }
+    }
+    return estimate;
+}
+
+void ht_hll_init(ht_hll* hll, const int precision) {
+    hll->precision = precision < 4 ? 4 : precision > 18 ? 18 : precision;
+    hll->registers = ht_calloc((size_t)1 << hll->precision, 1);
+}
+
+void ht_hll_free(ht_hll* hll) {
+    free(hll->registers);
+    hll->registers = NULL;
+}
+
+//the top precision bits pick the register, which keeps the longest run of leading zeros seen in the rest
+void ht_hll_add(ht_hll* hll, const uint64_t hash) {
+    const uint64_t h = ht_sketch_mix(hash);
+    const size_t index = (size_t)(h >> (64 - hll->precision));
+    //the bit set below the shifted out index caps the run, a hash of all zeros still ranks 64 - precision + 1
+    const uint64_t rest = (h << hll->precision) | (1ULL << (hll->precision - 1));
+    const uint8_t rank = (uint8_t)(__builtin_clzll(rest) + 1);
+    if (rank > hll->registers[index]) {
+        hll->registers[index] = rank;
+    }
+}
+
+//the harmonic mean estimate, switching to linear counting of the empty registers while few are filled
+double ht_hll_count(const ht_hll* hll) {
+    const size_t m = (size_t)1 << hll->precision;
+    double sum = 0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < m; i++) {
+        sum += 1.0 / (double)(1ULL << hll->registers[i]);
+        zeros += hll->registers[i] == 0;
+    }
+    const double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1 + 1.079 / (double)m);
+    const double estimate = alpha * (double)m * (double)m / sum;
+    if (estimate <= 2.5 * (double)m && zeros > 0) {
+        return (double)m * log((double)m / (double)zeros);
+    }
+    return estimate;
+}
+
+//width is the counters in each row, rounded up to a power of two and to at least a cache line
+void ht_count_init(ht_count_sketch* sketch, const size_t width) {
+    size_t row = HT_COUNT_BLOCK;
+    while (row < width) {
+        row <<= 1;
+    }
+    sketch->table = ht_aligned_alloc(64, row * HT_COUNT_DEPTH * sizeof(uint32_t));
+    memset(sketch->table, 0, row * HT_COUNT_DEPTH * sizeof(uint32_t));
+    sketch->row_mask = row - 1;
+}
+
+void ht_count_free(ht_count_sketch* sketch) {
+    free(sketch->table);
+    sketch->table = NULL;
+}
+
+//Each depth indexes its own row with 32 bits of the key's hash that no other depth uses: two mixes give 128 bits.
+//Deriving the rows from one pair of indexes (double hashing) would make two keys that share both collide in all.
+static void ht_count_counters(const ht_count_sketch* sketch, const uint64_t hash, uint32_t* counters[HT_COUNT_DEPTH]) {
+    const uint64_t h[2] = {ht_sketch_mix(hash), ht_sketch_mix(~hash)};
+    const size_t row = sketch->row_mask + 1;
+    for (int d = 0; d < HT_COUNT_DEPTH; d++) {
+        const size_t index = (size_t)(h[d / 2] >> (d % 2 * 32)) & sketch->row_mask;
+        counters[d] = sketch->table + (size_t)d * row + index;
+    }
+}
+
+//Counts one more occurrence and returns the new estimate. Written without branches on the counter values, which
+//are random from one key to the next, and every row is read before any is compared, so the four cache misses
+//overlap instead of following one another.
+uint32_t ht_count_add(ht_count_sketch* sketch, const uint64_t hash) {
+    uint32_t* counters[HT_COUNT_DEPTH];
+    uint32_t counts[HT_COUNT_DEPTH];
+    uint32_t estimate = UINT32_MAX;
+    ht_count_counters(sketch, hash, counters);
+    for (int d = 0; d < HT_COUNT_DEPTH; d++) {
+        counts[d] = *counters[d];
+        estimate = counts[d] < estimate ? counts[d] : estimate;
+    }
+    const uint32_t step = estimate != UINT32_MAX; //saturated, stop counting
+    for (int d = 0; d < HT_COUNT_DEPTH; d++) {
+        *counters[d] = counts[d] + (counts[d] == estimate ? step : 0);
+    }
+    return estimate + step;
+}
+
+uint32_t ht_count_estimate(const ht_count_sketch* sketch, const uint64_t hash) {
+    uint32_t* counters[HT_COUNT_DEPTH];
+    uint32_t estimate = UINT32_MAX;
+    ht_count_counters(sketch, hash, counters);
+    for (int d = 0; d < HT_COUNT_DEPTH; d++) {
+        const uint32_t count = *counters[d];
+        if (count < estimate) {
+            estimate = count;
+        }
+    }
+    return estimate;
+}
+
+static void ht_top_find_min(ht_top_keys* top) {
+    top->min = 0;
+    for (int i = 1; i < top->n; i++) {
+        if (top->counts[i] < top->counts[top->min]) {
+            top->min = i;
+        }
+    }
+}
+
+//Offers a key whose estimate has just reached count. Estimates only grow, so a key at or below the smallest
+//count kept cannot change the set and costs a single compare, the common case once the top k have settled.
+static void ht_top_offer(ht_top_keys* top, const char* key, const uint64_t hash, const uint32_t count) {
+    if (top->n == top->k && count <= top->counts[top->min]) {
+        return;
+    }
+    for (int i = 0; i < top->n; i++) {
+        if (top->hashes[i] == hash) {
+            top->counts[i] = count;
+            if (i == top->min) {
+                ht_top_find_min(top);
+            }
+            return;
+        }
+    }
+    int slot = top->n;
+    if (top->n < top->k) {
+        top->n++;
+    } else {
+        slot = top->min;
+        free(top->keys[slot]);
+    }
+    top->hashes[slot] = hash;
+    top->counts[slot] = count;
+    top->keys[slot] = ht_strdup(key);
+    ht_top_find_min(top);
+}
+
+ht_key_sketch* ht_key_sketch_new(const int precision, const size_t width, const int top_k) {
+    ht_key_sketch* sketch = ht_malloc(sizeof(ht_key_sketch));
+    ht_hll_init(&sketch->distinct, precision);
+    ht_count_init(&sketch->counts, width);
+    sketch->top.k = top_k > 0 ? top_k : 1;
+    sketch->top.n = 0;
+    sketch->top.min = 0;
+    sketch->top.hashes = ht_malloc(sizeof(uint64_t) * (size_t)sketch->top.k);
+    sketch->top.counts = ht_malloc(sizeof(uint32_t) * (size_t)sketch->top.k);
+    sketch->top.keys = ht_malloc(sizeof(char*) * (size_t)sketch->top.k);
+    return sketch;
+}
+
+void ht_key_sketch_free(ht_key_sketch* sketch) {
+    for (int i = 0; i < sketch->top.n; i++) {
+        free(sketch->top.keys[i]);
+    }
+    free(sketch->top.hashes);
+    free(sketch->top.counts);
+    free(sketch->top.keys);
+    ht_hll_free(&sketch->distinct);
+    ht_count_free(&sketch->counts);
+    free(sketch);
+}
+
+//counts one occurrence of key, hash being the hash the table already computed for it
+void ht_key_sketch_add(ht_key_sketch* sketch, const char* key, const uint64_t hash) {
+    ht_hll_add(&sketch->distinct, hash);
+    ht_top_offer(&sketch->top, key, hash, ht_count_add(&sketch->counts, hash));
+}
+
+double ht_key_sketch_distinct(const ht_key_sketch* sketch) {
+    return ht_hll_count(&sketch->distinct);
+}
+
+//Fills keys and counts with up to max heavy hitters, most frequent first, and returns how many. The counts are
+//count-min estimates, never below the true count. The key strings belong to the sketch and stay valid until the
+//key drops out of the top k.
+int ht_key_sketch_top(const ht_key_sketch* sketch, const char** keys, uint32_t* counts, const int max) {
+    const ht_top_keys* top = &sketch->top;
+    const int n = top->n < max ? top->n : max;
+    int last = -1;
+    for (int out = 0; out < n; out++) {
+        //selection by (count descending, index ascending), each pass takes the first entry ordered after the last
+        int best = -1;
+        for (int i = 0; i < top->n; i++) {
+            const int after_last = last < 0 || top->counts[i] < top->counts[last] ||
+                                   (top->counts[i] == top->counts[last] && i > last);
+            if (after_last && (best < 0 || top->counts[i] > top->counts[best])) {
+                best = i;
+            }
+        }
+        keys[out] = top->keys[best];
+        counts[out] = top->counts[best];
+        last = best;
+    }
+    return n;
+}
+
+//salts from the Parquet split block Bloom filter spec, each word's bit comes from a different multiply of the same 32 bits
+static const uint32_t HT_BLOOM_SALT[HT_BLOOM_BLOCK_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+void ht_bloom_init(ht_bloom* bloom, const size_t capacity) {
+    const size_t bits = (capacity > 0 ? capacity : 1) * HT_BLOOM_BITS_PER_KEY;
+    bloom->num_blocks = (bits + HT_BLOOM_BLOCK_WORDS * 32 - 1) / (HT_BLOOM_BLOCK_WORDS * 32);
+    const size_t bytes = bloom->num_blocks * HT_BLOOM_BLOCK_WORDS * sizeof(uint32_t);
+    bloom->words = ht_aligned_alloc(32, bytes);
+    memset(bloom->words, 0, bytes);
+}
+
+void ht_bloom_free(ht_bloom* bloom) {
+    free(bloom->words);
+    bloom->words = NULL;
+}
+
+size_t ht_bloom_bytes(const ht_bloom* bloom) {
+    return bloom->num_blocks * HT_BLOOM_BLOCK_WORDS * sizeof(uint32_t);
+}
+
+//the high half picks the block by multiply and shift, so any block count works, the low half picks the bits
+static uint32_t* ht_bloom_block(const ht_bloom* bloom, const uint64_t h) {
+    return bloom->words + (size_t)(((h >> 32) * bloom->num_blocks) >> 32) * HT_BLOOM_BLOCK_WORDS;
+}
+
+static uint32_t ht_bloom_bit(const uint64_t h, const int word) {
+    return 1U << (((uint32_t)h * HT_BLOOM_SALT[word]) >> 27);
+}
+
+void ht_bloom_add(ht_bloom* bloom, const uint64_t hash) {
+    const uint64_t h = ht_sketch_mix(hash);
+    uint32_t* block = ht_bloom_block(bloom, h);
+    for (int w = 0; w < HT_BLOOM_BLOCK_WORDS; w++) {
+        block[w] |= ht_bloom_bit(h, w);
+    }
+}
+
+//ht_bloom_add for several threads filling the same filter, as a parallel rehash does
+void ht_bloom_add_shared(ht_bloom* bloom, const uint64_t hash) {
+    const uint64_t h = ht_sketch_mix(hash);
+    uint32_t* block = ht_bloom_block(bloom, h);
+    for (int w = 0; w < HT_BLOOM_BLOCK_WORDS; w++) {
+        __atomic_fetch_or(&block[w], ht_bloom_bit(h, w), __ATOMIC_RELAXED);
+    }
+}
+
+//0 when the key was never added, checks all 8 words without branching on each
+int ht_bloom_may_contain(const ht_bloom* bloom, const uint64_t hash) {
+    const uint64_t h = ht_sketch_mix(hash);
+    const uint32_t* block = ht_bloom_block(bloom, h);
+    uint32_t missing = 0;
+    for (int w = 0; w < HT_BLOOM_BLOCK_WORDS; w++) {
+        const uint32_t bit = ht_bloom_bit(h, w);
+        missing |= ~block[w] & bit;
+    }
+    return missing == 0;
+}
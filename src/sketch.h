@@ -0,0 +1,114 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+//Small probabilistic summaries fed with key hashes the table has already computed.
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Count-min sketch of 4 bit counters with periodic aging, the frequency estimate behind TinyLFU admission.
+//The four counters of a key all sit in one 64 byte block, so an update or estimate touches a single cache line.
+typedef struct {
+    uint64_t* table; //16 counters per word, 8 words per block
+    size_t block_mask;
+    size_t additions;
+    size_t sample_size; //after this many increments every counter is halved so old popularity fades
+} ht_freq_sketch;
+
+void ht_freq_init(ht_freq_sketch* sketch, const size_t capacity);
+void ht_freq_free(ht_freq_sketch* sketch);
+void ht_freq_increment(ht_freq_sketch* sketch, const uint64_t hash);
+int ht_freq_estimate(const ht_freq_sketch* sketch, const uint64_t hash);
+
+//HyperLogLog distinct counter over 2^precision one byte registers, standard error about 1.04 / sqrt(2^precision)
+typedef struct {
+    uint8_t* registers;
+    int precision;
+} ht_hll;
+
+void ht_hll_init(ht_hll* hll, const int precision);
+void ht_hll_free(ht_hll* hll);
+void ht_hll_add(ht_hll* hll, const uint64_t hash);
+double ht_hll_count(const ht_hll* hll);
+
+//Count-min sketch of 32 bit counters for open ended counts, with conservative update: only the counters at the
+//current minimum are raised, which keeps the overestimate from collisions down. Unlike ht_freq_sketch each depth
+//has a row of its own, so a key's counters are on four cache lines, but two keys that collide in one row are no
+//more likely to collide in the next, which is what the count-min error bound rests on.
+typedef struct {
+    uint32_t* table; //one row per depth, row_mask + 1 counters each
+    size_t row_mask;
+} ht_count_sketch;
+
+void ht_count_init(ht_count_sketch* sketch, const size_t width);
+void ht_count_free(ht_count_sketch* sketch);
+uint32_t ht_count_add(ht_count_sketch* sketch, const uint64_t hash);
+uint32_t ht_count_estimate(const ht_count_sketch* sketch, const uint64_t hash);
+
+//the k keys with the highest count-min estimates seen so far, kept unsorted
+typedef struct {
+    int k;
+    int n;
+    int min; //entry with the lowest count, the one a new heavy hitter replaces
+    uint64_t* hashes;
+    uint32_t* counts;
+    char** keys; //copies, made when a key gets in
+} ht_top_keys;
+
+//What the table feeds when one is attached with ht_set_key_sketch: every key inserted is counted once by a
+//HyperLogLog for the number of distinct keys, and by a count-min sketch that feeds the top-k heavy hitters.
+typedef struct ht_key_sketch {
+    ht_hll distinct;
+    ht_count_sketch counts;
+    ht_top_keys top;
+} ht_key_sketch;
+
+//precision 4-18 (14 is 16KB for 0.8% error), width counters per count-min row, top_k heavy hitters
+ht_key_sketch* ht_key_sketch_new(const int precision, const size_t width, const int top_k);
+void ht_key_sketch_free(ht_key_sketch* sketch);
+void ht_key_sketch_add(ht_key_sketch* sketch, const char* key, const uint64_t hash);
+double ht_key_sketch_distinct(const ht_key_sketch* sketch);
+int ht_key_sketch_top(const ht_key_sketch* sketch, const char** keys, uint32_t* counts, const int max);
+
+//Split block Bloom filter: a key sets one bit in each of the 8 words of a 32 byte block, so adding or checking a
+//key reads a single cache line. Only ever answers "maybe" or "definitely not", and a key cannot be taken back out.
+typedef struct ht_bloom {
+    uint32_t* words; //8 per block
+    size_t num_blocks;
+} ht_bloom;
+
+//sizes the filter for capacity keys at HT_BLOOM_BITS_PER_KEY, about 0.5% false positives when full
+void ht_bloom_init(ht_bloom* bloom, const size_t capacity);
+void ht_bloom_free(ht_bloom* bloom);
+void ht_bloom_add(ht_bloom* bloom, const uint64_t hash);
+void ht_bloom_add_shared(ht_bloom* bloom, const uint64_t hash);
+int ht_bloom_may_contain(const ht_bloom* bloom, const uint64_t hash);
+size_t ht_bloom_bytes(const ht_bloom* bloom);
+
+//spreads the bits of a key hash, the fast polynomial hash is too regular to index a sketch with directly
+static inline uint64_t ht_sketch_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+#endif
@@ -0,0 +1,184 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#define _GNU_SOURCE //MAP_HUGETLB, MADV_HUGEPAGE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "hash_table_internal.h"
+#include "placement.h"
+#include "slots.h"
+
+#define HT_SLOTS_ALIGN 64
+#define HT_PAGE_4K ((size_t)4096)
+#define HT_PAGE_2M ((size_t)2 << 20)
+#define HT_PAGE_1G ((size_t)1 << 30)
+#define HT_SLOTS_MAP_MIN HT_PAGE_2M //arrays smaller than one huge page stay on the heap
+#define HT_PREFAULT_GRAIN 8 //2MB units per ht_slots_prefault chunk
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+#define HT_MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT) //log2 of the page size, glibc only has these in linux/mman.h
+#define HT_MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+//kept in the HT_SLOTS_ALIGN bytes in front of the slots so that freeing needs nothing but the pointer
+typedef struct {
+    void* base; //start of the allocation or mapping
+    size_t length; //bytes mapped, 0 for a heap allocation
+    size_t page_size;
+} ht_slots_header;
+
+static ht_slots_header* ht_slots_header_of(ht_item* const* slots) {
+    return (ht_slots_header*)((char*)slots - HT_SLOTS_ALIGN);
+}
+
+static size_t ht_round_up(const size_t n, const size_t to) {
+    return (n + to - 1) / to * to;
+}
+
+#ifdef HT_MAP_HUGE_2MB
+//a hugetlb mapping of length bytes, NULL when the pool of reserved huge pages of that size cannot cover it
+static void* ht_slots_map_hugetlb(const size_t length, const int size_flag) {
+    void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+}
+#endif
+
+//Ordinary anonymous memory trimmed to start on a 2MB boundary, where transparent huge pages can back it.
+//MADV_HUGEPAGE makes that happen even when THP is set to madvise only, and is ignored where THP is off.
+//MAP_NORESERVE lets a presized table map more than the machine could back right now, as long as it never fills up.
+static void* ht_slots_map_thp(const size_t length) {
+    const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    char* p = mmap(NULL, length + HT_PAGE_2M, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    char* start = (char*)ht_round_up((uintptr_t)p, HT_PAGE_2M);
+    if (start > p) {
+        munmap(p, (size_t)(start - p));
+    }
+    munmap(start + length, (size_t)(p + HT_PAGE_2M - start));
+#ifdef MADV_HUGEPAGE
+    madvise(start, length, MADV_HUGEPAGE);
+#endif
+    return start;
+}
+
+//maps bytes for a large array, trying 1GB then 2MB hugetlb pages before falling back on transparent huge pages
+static ht_slots_header* ht_slots_map(const size_t bytes) {
+    size_t length = 0;
+    size_t page_size = HT_PAGE_4K;
+    void* base = NULL;
+#ifdef HT_MAP_HUGE_2MB
+    if (bytes >= HT_PAGE_1G) {
+        length = ht_round_up(bytes, HT_PAGE_1G);
+        page_size = HT_PAGE_1G;
+        base = ht_slots_map_hugetlb(length, HT_MAP_HUGE_1GB);
+    }
+    if (base == NULL) {
+        length = ht_round_up(bytes, HT_PAGE_2M);
+        page_size = HT_PAGE_2M;
+        base = ht_slots_map_hugetlb(length, HT_MAP_HUGE_2MB);
+    }
+#endif
+    if (base == NULL) {
+        length = ht_round_up(bytes, HT_PAGE_2M);
+        page_size = HT_PAGE_4K;
+        base = ht_slots_map_thp(length);
+    }
+    if (base == NULL) {
+        return NULL;
+    }
+    ht_slots_header* header = base;
+    header->base = base;
+    header->length = length;
+    header->page_size = page_size;
+    return header;
+}
+
+ht_item** ht_slots_alloc(const size_t count) {
+    const size_t bytes = HT_SLOTS_ALIGN + count * sizeof(ht_item*);
+    ht_slots_header* header = NULL;
+    if (bytes >= HT_SLOTS_MAP_MIN) {
+        header = ht_slots_map(bytes); //fresh mappings are already zeroed
+    }
+    if (header == NULL) {
+        header = ht_aligned_alloc(HT_SLOTS_ALIGN, ht_round_up(bytes, HT_SLOTS_ALIGN));
+        memset(header, 0, bytes);
+        header->base = header;
+        header->length = 0;
+        header->page_size = HT_PAGE_4K;
+    }
+    return (ht_item**)((char*)header + HT_SLOTS_ALIGN);
+}
+
+void ht_slots_free(ht_item** slots) {
+    if (slots == NULL) {
+        return;
+    }
+    const ht_slots_header* header = ht_slots_header_of(slots);
+    if (header->length > 0) {
+        munmap(header->base, header->length);
+    } else {
+        free(header->base);
+    }
+}
+
+int ht_slots_place(ht_item** slots, const int numa, const int move) {
+    const ht_slots_header* header = ht_slots_header_of(slots);
+    if (header->length == 0) {
+        return 0;
+    }
+    return ht_numa_bind(header->base, header->length, numa, move);
+}
+
+//Faults in [begin, end) 2MB units of the mapping ctx heads. MADV_POPULATE_WRITE (Linux 5.14) does it in one call,
+//before that a no-op atomic add on every 4KB page does it the slow way without racing with anything.
+static void ht_slots_prefault_chunk(void* ctx, const size_t begin, const size_t end, const int worker) {
+    (void)worker;
+    const ht_slots_header* header = ctx;
+    char* const start = (char*)header->base + begin * HT_PAGE_2M;
+    const size_t limit = end * HT_PAGE_2M < header->length ? end * HT_PAGE_2M : header->length;
+    const size_t length = limit - begin * HT_PAGE_2M;
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(start, length, MADV_POPULATE_WRITE) == 0) {
+        return;
+    }
+#endif
+    for (size_t off = 0; off < length; off += HT_PAGE_4K) {
+        __atomic_fetch_add(start + off, 0, __ATOMIC_RELAXED);
+    }
+}
+
+void ht_slots_prefault(ht_item** slots, ht_thread_pool* pool) {
+    ht_slots_header* header = ht_slots_header_of(slots);
+    if (header->length == 0) {
+        return; //heap arrays were zeroed, so already touched
+    }
+    const size_t units = (header->length + HT_PAGE_2M - 1) / HT_PAGE_2M;
+    if (pool != NULL) {
+        ht_pool_run(pool, units, HT_PREFAULT_GRAIN, ht_slots_prefault_chunk, header);
+    } else {
+        ht_slots_prefault_chunk(header, 0, units, 0);
+    }
+}
+
+size_t ht_slots_page_size(ht_item* const* slots) {
+    return ht_slots_header_of(slots)->page_size;
+}
@@ -0,0 +1,42 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#ifndef SLOTS_H
+#define SLOTS_H
+
+//Allocation of the slot arrays every layout keeps in ht->items. Small arrays come from the heap. Large ones are
+//mapped directly, so their pages cost nothing until first touched and allocating one is O(1) whatever its size,
+//onto huge pages when the system has any to give, and onto 2MB aligned memory the kernel is asked
+//to back with transparent huge pages otherwise, so a table of tens of GB does not need millions of 4KB TLB entries.
+
+#include <stddef.h>
+
+#include "hash_table.h"
+#include "thread_pool.h"
+
+//returns count zeroed slots, 64 byte aligned so the first slot of every cache line is at a multiple of 8
+ht_item** ht_slots_alloc(const size_t count);
+void ht_slots_free(ht_item** slots);
+//the page size backing slots: 4KB for heap arrays and the transparent huge page fallback, 2MB or 1GB for hugetlb
+size_t ht_slots_page_size(ht_item* const* slots);
+//Puts the pages of a mapped slot array on the NUMA node(s) numa names, see ht_numa_bind. Meant for an array nothing
+//has been stored in yet, unless move is set. Heap allocated arrays, the small ones, are left where they are.
+int ht_slots_place(ht_item** slots, const int numa, const int move);
+//faults in every page of a mapped slot array, in parallel over pool when it is not NULL, without changing any slot
+void ht_slots_prefault(ht_item** slots, ht_thread_pool* pool);
+
+#endif
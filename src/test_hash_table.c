@@ -0,0 +1,1364 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+//Behaviour checks for the table and the modules built on it, one test function per feature. Prints each failed check
+//and exits 1 if there was one; build it with -fsanitize=address,undefined to catch memory errors on the same paths.
+//Adding -DHT_INSTRUMENT checks the hot path counters as well.
+//Build: gcc -O2 -pthread -o test_hash_table test_hash_table.c cache.c hash_table.c intern.c memcache.c placement.c
+//       prime.c replica.c server.c server_uring.c shard.c siphash.c sketch.c slots.c timer_wheel.c thread_pool.c
+//       instrument.c cuckoo.c hopscotch.c -lm
+//Usage: ./test_hash_table
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "cache.h"
+#include "hash_table.h"
+#include "instrument.h"
+#include "intern.h"
+#include "memcache.h"
+#include "placement.h"
+#include "replica.h"
+#include "server.h"
+#include "shard.h"
+#include "sketch.h"
+#include "slots.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
+
+#define TEST_KEYS 2000
+
+static int failures;
+
+#define TEST_CHECK(cond)                                                             \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                              \
+        }                                                                            \
+    } while (0)
+
+//moves the table's TTL clock forward without sleeping, the wheel measures time from start_ms
+static void test_advance(ht_hash_table* ht, const uint64_t ms) {
+    ht->wheel->start_ms -= ms;
+}
+
+static int test_value_is(ht_hash_table* ht, const char* key, const char* expected) {
+    const char* value = ht_search(ht, key);
+    return value != NULL && strcmp(value, expected) == 0;
+}
+
+//insert, overwrite, delete and the resizes they cause, on each layout
+static void test_basic(const int layout) {
+    ht_hash_table* ht = layout == HT_LAYOUT_OPEN ? ht_new() : ht_new_layout(layout);
+    const int initial_size = ht->size;
+    char key[32];
+    char value[32];
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "v%d", i);
+        ht_insert(ht, key, value);
+    }
+    TEST_CHECK(ht->count == TEST_KEYS);
+    TEST_CHECK(ht->size > initial_size);
+    for (int i = 0; i < TEST_KEYS; i += 2) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ht_insert(ht, key, "overwritten");
+    }
+    TEST_CHECK(ht->count == TEST_KEYS);
+    const int grown_size = ht->size;
+    for (int i = 0; i < TEST_KEYS; i++) {
+        if (i % 10 != 0) {
+            snprintf(key, sizeof(key), "k%d", i);
+            ht_delete(ht, key);
+        }
+    }
+    TEST_CHECK(ht->count == TEST_KEYS / 10);
+    ht_delete(ht, "k1");
+    TEST_CHECK(ht->count == TEST_KEYS / 10);
+    TEST_CHECK(ht_search(ht, "none") == NULL);
+    if (layout == HT_LAYOUT_OPEN) {
+        TEST_CHECK(ht->size < grown_size); //only open addressing shrinks on delete
+    }
+    int bad = 0;
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        if (i % 10 != 0) {
+            bad += ht_search(ht, key) != NULL;
+        } else {
+            bad += !test_value_is(ht, key, "overwritten"); //every tenth key is even
+        }
+    }
+    TEST_CHECK(bad == 0);
+    ht_delete_hash_table(ht);
+}
+
+//the counters ht_stats reports follow every insert, overwrite, delete and lookup
+static void test_stats(void) {
+    ht_hash_table* ht = ht_new();
+    ht_statistics st;
+    ht_insert(ht, "a", "1");
+    ht_insert(ht, "bb", "22");
+    ht_insert(ht, "a", "333");
+    ht_stats(ht, &st);
+    TEST_CHECK(st.count == 2);
+    TEST_CHECK(st.size == ht->size);
+    TEST_CHECK(st.key_bytes == 2 + 3);
+    TEST_CHECK(st.value_bytes == 4 + 3);
+    TEST_CHECK(st.item_bytes == 2 * sizeof(ht_item));
+    TEST_CHECK(st.slot_bytes == (size_t)ht->size * sizeof(ht_item*));
+    ht_delete(ht, "bb");
+    ht_delete(ht, "bb");
+    ht_stats(ht, &st);
+    TEST_CHECK(st.count == 1);
+    TEST_CHECK(st.tombstones == 1);
+    TEST_CHECK(st.key_bytes == 2);
+    TEST_CHECK(st.value_bytes == 4);
+    TEST_CHECK(st.load_factor == 2.0 / st.size);
+    unsigned long hits = 0;
+    unsigned long misses = 0;
+    ht_search(ht, "a");
+    ht_search(ht, "bb");
+    ht_search(ht, "c");
+    ht_stats(ht, &st);
+    for (int b = 0; b < HT_PROBE_HIST_BUCKETS; b++) {
+        hits += st.hit_probes[b];
+        misses += st.miss_probes[b];
+    }
+    TEST_CHECK(hits == 1);
+    TEST_CHECK(misses == 2);
+    //items that head a larger struct are charged for all of it
+    ht_insert_ttl(ht, "t", "1", 60);
+    ht_stats(ht, &st);
+    TEST_CHECK(st.item_bytes == sizeof(ht_item) + sizeof(ht_ttl_item));
+    ht_insert(ht, "t", "2");
+    ht_stats(ht, &st);
+    TEST_CHECK(st.item_bytes == 2 * sizeof(ht_item));
+    ht_delete_hash_table(ht);
+    ht_cache* cache = ht_cache_new(HT_CACHE_LRU, 2, 0, NULL, NULL);
+    ht_cache_put(cache, "a", "1");
+    ht_cache_put(cache, "b", "2");
+    ht_cache_put(cache, "c", "3");
+    ht_stats(cache->table, &st);
+    TEST_CHECK(st.item_bytes == 2 * sizeof(ht_cache_entry));
+    ht_cache_free(cache);
+}
+
+//the counters follow each operation when the build defines HT_INSTRUMENT, and read as zero when it does not
+static void test_instrument(void) {
+    ht_op_counters before;
+    ht_op_counters after;
+    ht_hash_table* ht = ht_new();
+    ht_instrument_snapshot(&before);
+    ht_insert(ht, "a", "1");
+    ht_insert(ht, "b", "2");
+    ht_search(ht, "a");
+    ht_search(ht, "c");
+    ht_delete(ht, "b");
+    ht_instrument_snapshot(&after);
+#ifdef HT_INSTRUMENT
+    TEST_CHECK(after.inserts - before.inserts == 2);
+    TEST_CHECK(after.searches - before.searches == 2);
+    TEST_CHECK(after.deletes - before.deletes == 1);
+    TEST_CHECK(after.search_probes - before.search_probes >= 2);
+#else
+    const ht_op_counters zero = {0};
+    TEST_CHECK(memcmp(&before, &zero, sizeof(zero)) == 0);
+    TEST_CHECK(memcmp(&after, &zero, sizeof(zero)) == 0);
+#endif
+    ht_delete_hash_table(ht);
+}
+
+//a seeded table works like any other, under a seed of its own that survives its resizes
+static void test_seeded(void) {
+    ht_hash_table* ht = ht_new_seeded();
+    ht_hash_table* other = ht_new_seeded();
+    TEST_CHECK(ht->hash_mode == HT_HASH_SIPHASH);
+    TEST_CHECK(ht->seed[0] != other->seed[0] || ht->seed[1] != other->seed[1]);
+    const uint64_t seed0 = ht->seed[0];
+    char key[32];
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "seeded key %d", i);
+        ht_insert(ht, key, key);
+    }
+    for (int i = 0; i < TEST_KEYS; i += 2) {
+        snprintf(key, sizeof(key), "seeded key %d", i);
+        ht_delete(ht, key);
+    }
+    TEST_CHECK(ht->count == TEST_KEYS / 2);
+    TEST_CHECK(ht->seed[0] == seed0);
+    int bad = 0;
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "seeded key %d", i);
+        bad += i % 2 == 0 ? ht_search(ht, key) != NULL : !test_value_is(ht, key, key);
+    }
+    TEST_CHECK(bad == 0);
+    ht_delete_hash_table(other);
+    ht_delete_hash_table(ht);
+}
+
+//Keys made of 128 byte blocks of a Thue-Morse string and its complement all share one fast hash, their polynomials
+//differ by a multiple of 2^32 for any odd multiplier. Enough of them must move the table onto SipHash.
+static void test_flood(void) {
+    char blocks[2][129];
+    for (int i = 0; i < 128; i++) {
+        const int parity = __builtin_popcount((unsigned int)i) & 1;
+        blocks[0][i] = parity ? 'b' : 'a';
+        blocks[1][i] = parity ? 'a' : 'b';
+    }
+    blocks[0][128] = '\0';
+    blocks[1][128] = '\0';
+    ht_hash_table* ht = ht_new();
+    const int n = 128; //every 7 block key
+    char key[7 * 128 + 1];
+    for (int k = 0; k < n; k++) {
+        key[0] = '\0';
+        for (int b = 0; b < 7; b++) {
+            strcat(key, blocks[(k >> b) & 1]);
+        }
+        ht_insert(ht, key, "flood");
+    }
+    TEST_CHECK(ht->reseeds >= 1);
+    TEST_CHECK(ht->hash_mode == HT_HASH_SIPHASH);
+    TEST_CHECK(ht->count == n);
+    int missing = 0;
+    for (int k = 0; k < n; k++) {
+        key[0] = '\0';
+        for (int b = 0; b < 7; b++) {
+            strcat(key, blocks[(k >> b) & 1]);
+        }
+        missing += !test_value_is(ht, key, "flood");
+    }
+    TEST_CHECK(missing == 0);
+    ht_delete_hash_table(ht);
+}
+
+static void test_cache_count_evict(const char* key, const char* value, void* ctx) {
+    (void)key;
+    (void)value;
+    (*(int*)ctx)++;
+}
+
+//LRU order, CLOCK second chance, the byte limit and the eviction callback
+static void test_cache(void) {
+    int evicted = 0;
+    ht_cache* lru = ht_cache_new(HT_CACHE_LRU, 3, 0, test_cache_count_evict, &evicted);
+    ht_cache_put(lru, "a", "1");
+    ht_cache_put(lru, "b", "2");
+    ht_cache_put(lru, "c", "3");
+    TEST_CHECK(ht_cache_get(lru, "a") != NULL); //b is now the oldest
+    ht_cache_put(lru, "d", "4");
+    TEST_CHECK(ht_cache_get(lru, "b") == NULL);
+    TEST_CHECK(ht_cache_get(lru, "a") != NULL && strcmp(ht_cache_get(lru, "a"), "1") == 0);
+    TEST_CHECK(evicted == 1 && lru->evictions == 1);
+    ht_cache_put(lru, "c", "33");
+    TEST_CHECK(strcmp(ht_cache_get(lru, "c"), "33") == 0);
+    ht_cache_remove(lru, "d");
+    TEST_CHECK(ht_cache_get(lru, "d") == NULL);
+    TEST_CHECK(evicted == 1 && lru->table->count == 2);
+    TEST_CHECK(lru->misses == 2);
+    ht_cache_free(lru);
+
+    ht_cache* clock = ht_cache_new(HT_CACHE_CLOCK, 3, 0, NULL, NULL);
+    ht_cache_put(clock, "a", "1");
+    ht_cache_put(clock, "b", "2");
+    ht_cache_put(clock, "c", "3");
+    ht_cache_get(clock, "a"); //referenced, so the hand passes over it once
+    ht_cache_put(clock, "d", "4");
+    TEST_CHECK(ht_cache_get(clock, "a") != NULL);
+    TEST_CHECK(ht_cache_get(clock, "b") == NULL);
+    ht_cache_free(clock);
+
+    char key[32];
+    const size_t max_bytes = 16 * (sizeof(ht_cache_entry) + 16);
+    ht_cache* bounded = ht_cache_new(HT_CACHE_LRU, 0, max_bytes, NULL, NULL);
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ht_cache_put(bounded, key, "value");
+        TEST_CHECK(bounded->bytes <= max_bytes);
+    }
+    TEST_CHECK(bounded->table->count > 0 && bounded->evictions > 0);
+    snprintf(key, sizeof(key), "k%d", TEST_KEYS - 1);
+    TEST_CHECK(ht_cache_get(bounded, key) != NULL);
+    //a value larger than the whole budget is refused instead of flushing everything and then itself
+    char big[sizeof(ht_cache_entry) * 16 + 512];
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    const unsigned long evictions = bounded->evictions;
+    const int count = bounded->table->count;
+    ht_cache_put(bounded, "big", big);
+    TEST_CHECK(bounded->rejections == 1 && bounded->evictions == evictions);
+    TEST_CHECK(bounded->table->count == count && ht_cache_get(bounded, "big") == NULL);
+    ht_cache_put(bounded, key, big); //replacing a key with one drops the old value
+    TEST_CHECK(bounded->rejections == 2 && ht_cache_get(bounded, key) == NULL);
+    TEST_CHECK(bounded->table->count == count - 1 && bounded->bytes <= max_bytes);
+    ht_cache_free(bounded);
+}
+
+//with TinyLFU admission a scan of one-off keys is turned away instead of flushing the keys still in use, where plain
+//LRU would lose them all: the scan puts 64 new keys between two uses of each hot key
+static int test_cache_get_or_put(ht_cache* cache, const char* key) {
+    if (ht_cache_get(cache, key) != NULL) {
+        return 1;
+    }
+    ht_cache_put(cache, key, "v");
+    return 0;
+}
+
+static void test_cache_admission(void) {
+    char key[32];
+    ht_cache* cache = ht_cache_new(HT_CACHE_LRU, 64, 0, NULL, NULL);
+    ht_cache_enable_admission(cache, 64);
+    for (int i = 0; i < 4 * 64; i++) {
+        snprintf(key, sizeof(key), "hot%d", i % 64);
+        test_cache_get_or_put(cache, key);
+    }
+    int hot_hits = 0;
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "scan%d", i);
+        test_cache_get_or_put(cache, key);
+        snprintf(key, sizeof(key), "hot%d", i % 64);
+        hot_hits += test_cache_get_or_put(cache, key);
+    }
+    TEST_CHECK(hot_hits > TEST_KEYS * 9 / 10);
+    TEST_CHECK(cache->rejections > 0);
+    ht_cache_free(cache);
+}
+
+//expiry on lookup and by ht_expire, with TTL and plain items side by side
+static void test_ttl(void) {
+    ht_hash_table* ht = ht_new();
+    ht_insert_ttl(ht, "short", "1", 1);
+    ht_insert_ttl(ht, "long", "2", 3600);
+    ht_insert(ht, "plain", "3");
+    ht_insert_ttl(ht, "short", "4", 1);
+    TEST_CHECK(ht->count == 3);
+    TEST_CHECK(test_value_is(ht, "short", "4"));
+    test_advance(ht, 2000);
+    TEST_CHECK(ht_search(ht, "short") == NULL);
+    TEST_CHECK(test_value_is(ht, "long", "2"));
+    TEST_CHECK(test_value_is(ht, "plain", "3"));
+    TEST_CHECK(ht->count == 2);
+
+    ht_insert_ttl(ht, "swept", "5", 1);
+    test_advance(ht, 2000);
+    TEST_CHECK(ht_expire(ht, 100) == 1);
+    TEST_CHECK(ht->count == 2);
+    ht_delete(ht, "long");
+    TEST_CHECK(ht->count == 1);
+    TEST_CHECK(ht_expire(ht, 100) == 0);
+    ht_delete_hash_table(ht);
+}
+
+static void test_scan_mark(const char* key, const char* value, void* ctx) {
+    (void)value;
+    if (key[0] == 'k') {
+        ((char*)ctx)[atoi(key + 1)] = 1;
+    }
+}
+
+//a full iterator walk, then a scan with enough inserts between calls to resize the table under it
+static void test_iter(const int layout) {
+    ht_hash_table* ht = layout == HT_LAYOUT_OPEN ? ht_new() : ht_new_layout(layout);
+    char key[32];
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ht_insert(ht, key, "v");
+    }
+    ht_iter it;
+    const char* k;
+    const char* v;
+    int walked = 0;
+    ht_iter_begin(ht, &it);
+    while (ht_iter_next(&it, &k, &v)) {
+        walked++;
+    }
+    TEST_CHECK(walked == TEST_KEYS);
+
+    char seen[TEST_KEYS] = {0};
+    const int size_before = ht->size;
+    int added = 0;
+    unsigned long long cursor = 0;
+    do {
+        cursor = ht_scan(ht, cursor, 16, test_scan_mark, seen);
+        for (int i = 0; i < 50 && added < 2 * TEST_KEYS; i++, added++) {
+            snprintf(key, sizeof(key), "x%d", added);
+            ht_insert(ht, key, "v");
+        }
+    } while (cursor != 0);
+    TEST_CHECK(ht->size > size_before);
+    int missing = 0;
+    for (int i = 0; i < TEST_KEYS; i++) {
+        missing += !seen[i];
+    }
+    TEST_CHECK(missing == 0);
+
+    //a count below 1 still moves the walk on, one slot a call
+    memset(seen, 0, sizeof(seen));
+    cursor = ht_scan(ht, 0, 0, test_scan_mark, seen);
+    TEST_CHECK((cursor & ((1ULL << 40) - 1)) == 1); //the slot index sits below HT_SCAN_EPOCH_SHIFT
+    int calls = 1;
+    while (cursor != 0) {
+        cursor = ht_scan(ht, cursor, -5, test_scan_mark, seen);
+        calls++;
+    }
+    TEST_CHECK(calls == ht->size);
+    missing = 0;
+    for (int i = 0; i < TEST_KEYS; i++) {
+        missing += !seen[i];
+    }
+    TEST_CHECK(missing == 0);
+    ht_delete_hash_table(ht);
+}
+
+typedef struct {
+    long count;
+    long sum;
+} test_totals;
+
+static void test_pool_mark(void* ctx, size_t begin, size_t end, int worker) {
+    (void)worker;
+    for (size_t i = begin; i < end; i++) {
+        __atomic_add_fetch(&((int*)ctx)[i], 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void test_sum_entry(const char* key, const char* value, void* local) {
+    (void)key;
+    test_totals* t = local;
+    t->count++;
+    t->sum += atoi(value);
+}
+
+static void test_sum_merge(void* result, const void* local) {
+    test_totals* r = result;
+    const test_totals* l = local;
+    r->count += l->count;
+    r->sum += l->sum;
+}
+
+//every index of a pool run is handed out exactly once, and a parallel sum matches the serial one
+static void test_parallel(void) {
+    ht_thread_pool* pool = ht_pool_new(4);
+    TEST_CHECK(ht_pool_threads(pool) == 4);
+    const size_t n = 100003;
+    int* marks = calloc(n, sizeof(int));
+    ht_pool_run(pool, n, 64, test_pool_mark, marks);
+    int bad = 0;
+    for (size_t i = 0; i < n; i++) {
+        bad += marks[i] != 1;
+    }
+    TEST_CHECK(bad == 0);
+    free(marks);
+
+    ht_hash_table* ht = ht_new();
+    char key[32];
+    char value[32];
+    long expected = 0;
+    for (int i = 0; i < 10 * TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        ht_insert(ht, key, value);
+        expected += i;
+    }
+    test_totals totals = {0, 0};
+    ht_parallel_for_each(ht, pool, test_sum_entry, sizeof(test_totals), test_sum_merge, &totals);
+    TEST_CHECK(totals.count == 10 * TEST_KEYS);
+    TEST_CHECK(totals.sum == expected);
+    ht_delete_hash_table(ht);
+    ht_pool_free(pool);
+}
+
+//grows a table past HT_PARALLEL_RESIZE_MIN items so its resizes rehash on the pool, then checks every key
+static void test_parallel_resize(void) {
+    ht_thread_pool* pool = ht_pool_new(4);
+    ht_hash_table* ht = ht_new();
+    ht_set_resize_pool(ht, pool);
+    const int n = 200000;
+    char key[32];
+    char value[32];
+    for (int i = 0; i < n; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        ht_insert(ht, key, value);
+    }
+    TEST_CHECK(ht->count == n);
+    int bad = 0;
+    for (int i = 0; i < n; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "%d", i);
+        bad += !test_value_is(ht, key, value);
+    }
+    TEST_CHECK(bad == 0);
+    ht_delete_hash_table(ht);
+    ht_pool_free(pool);
+}
+
+//ht_upsert callback that keeps a decimal counter, growing it into a new string when it runs out of digits
+static char* test_bump(const char* key, char* value, void* ctx) {
+    (void)key;
+    (void)ctx;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%d", value == NULL ? 1 : atoi(value) + 1);
+    if (value != NULL && strlen(buf) == strlen(value)) {
+        memcpy(value, buf, strlen(buf));
+        return value;
+    }
+    return strdup(buf);
+}
+
+static char* test_refuse(const char* key, char* value, void* ctx) {
+    (void)key;
+    (void)value;
+    (void)ctx;
+    return NULL;
+}
+
+//find-or-insert and read-modify-write, each in one probe
+static void test_upsert(const int layout) {
+    ht_hash_table* ht = layout == HT_LAYOUT_OPEN ? ht_new() : ht_new_layout(layout);
+    int inserted = 0;
+    ht_item* item = ht_find_or_insert(ht, "a", "1", &inserted);
+    TEST_CHECK(inserted == 1 && strcmp(item->value, "1") == 0);
+    item = ht_find_or_insert(ht, "a", "2", &inserted);
+    TEST_CHECK(inserted == 0 && strcmp(item->value, "1") == 0);
+    TEST_CHECK(ht->count == 1);
+
+    for (int i = 0; i < 120; i++) {
+        ht_upsert(ht, "counter", test_bump, NULL);
+    }
+    TEST_CHECK(test_value_is(ht, "counter", "120"));
+    TEST_CHECK(ht_upsert(ht, "missing", test_refuse, NULL) == NULL);
+    TEST_CHECK(ht_search(ht, "missing") == NULL);
+    TEST_CHECK(ht->count == 2);
+    ht_delete_hash_table(ht);
+}
+
+//borrowed strings are stored by reference and never freed by the table, which ASan builds would catch
+static void test_borrowed(void) {
+    static char key[] = "borrowed";
+    static char value[] = "value";
+    ht_hash_table* ht = ht_new();
+    ht_insert_borrowed(ht, key, value, HT_ITEM_BORROWED_KEY | HT_ITEM_BORROWED_VALUE);
+    TEST_CHECK(ht_search(ht, "borrowed") == value);
+    ht_insert_borrowed(ht, "copied", value, HT_ITEM_BORROWED_VALUE);
+    TEST_CHECK(ht_search(ht, "copied") == value);
+    ht_insert(ht, key, "replaced");
+    TEST_CHECK(test_value_is(ht, "borrowed", "replaced"));
+    ht_delete(ht, "copied");
+
+    ht_set_borrow(ht, HT_ITEM_BORROWED_KEY);
+    char keys[TEST_KEYS][16];
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "b%d", i);
+        ht_insert(ht, keys[i], "v");
+    }
+    TEST_CHECK(ht_find_or_insert(ht, keys[TEST_KEYS - 1], "v", NULL)->key == keys[TEST_KEYS - 1]);
+    TEST_CHECK(ht->count == TEST_KEYS + 1);
+    ht_delete_hash_table(ht);
+    TEST_CHECK(strcmp(key, "borrowed") == 0 && strcmp(value, "value") == 0);
+}
+
+typedef struct {
+    ht_interner* interner;
+    const char** interned; //what the first TEST_KEYS strings were interned as
+    int stop;
+    int bad;
+} test_intern_reader;
+
+//looks up the strings interned before it started until told to stop, counting any lookup that comes back wrong
+static void* test_intern_read(void* arg) {
+    test_intern_reader* r = arg;
+    char s[32];
+    while (!__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < TEST_KEYS; i++) {
+            snprintf(s, sizeof(s), "s%d", i);
+            if (ht_intern_lookup(r->interner, s) != r->interned[i] ||
+                ht_intern_string(r->interner, ht_intern_id(r->interned[i])) != r->interned[i]) {
+                r->bad++;
+            }
+        }
+    }
+    return NULL;
+}
+
+//one copy and one id per distinct string, with lock-free readers running while the table grows several times
+static void test_intern(void) {
+    ht_interner* interner = ht_intern_new();
+    const char** interned = malloc(TEST_KEYS * sizeof(const char*));
+    char s[32];
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(s, sizeof(s), "s%d", i);
+        interned[i] = ht_intern(interner, s);
+        TEST_CHECK(strcmp(interned[i], s) == 0 && ht_intern_id(interned[i]) == (uint32_t)i);
+    }
+    TEST_CHECK(ht_intern(interner, "s7") == interned[7]);
+    TEST_CHECK(ht_intern_lookup(interner, "absent") == NULL);
+    TEST_CHECK(ht_intern_count(interner) == TEST_KEYS);
+
+    test_intern_reader readers[2];
+    pthread_t threads[2];
+    for (int t = 0; t < 2; t++) {
+        readers[t] = (test_intern_reader){interner, interned, 0, 0};
+        pthread_create(&threads[t], NULL, test_intern_read, &readers[t]);
+    }
+    const int table_size = interner->table->size;
+    for (int i = 0; i < 50 * TEST_KEYS; i++) {
+        snprintf(s, sizeof(s), "n%d", i);
+        ht_intern(interner, s);
+    }
+    TEST_CHECK(interner->table->size > table_size);
+    for (int t = 0; t < 2; t++) {
+        __atomic_store_n(&readers[t].stop, 1, __ATOMIC_RELEASE);
+        pthread_join(threads[t], NULL);
+        TEST_CHECK(readers[t].bad == 0);
+    }
+    TEST_CHECK(ht_intern_count(interner) == 51 * TEST_KEYS);
+    free(interned);
+    ht_intern_free(interner);
+}
+
+static void test_request(ht_buf* buf, const int op, const char* key, const char* value) {
+    const ht_request_header h = {(uint8_t)op, 0, (uint16_t)strlen(key), value != NULL ? (uint32_t)strlen(value) : 0};
+    ht_buf_append(buf, &h, sizeof(h));
+    ht_buf_append(buf, key, strlen(key));
+    if (value != NULL) {
+        ht_buf_append(buf, value, strlen(value));
+    }
+}
+
+typedef struct {
+    ht_server* server;
+    int uring;
+    int result;
+} test_server_thread;
+
+static void* test_server_main(void* arg) {
+    test_server_thread* t = arg;
+    t->result = t->uring ? ht_server_run_uring(t->server) : ht_server_run(t->server);
+    return NULL;
+}
+
+//Connects to the server at path, writes req in one go and reads up to want bytes of replies into reply, giving up
+//after two quiet seconds. Returns the bytes read.
+static size_t test_exchange(const char* path, const ht_buf* req, char* reply, const size_t want) {
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, path);
+    size_t got = 0;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 && write(fd, req->data, req->len) == (ssize_t)req->len) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        while (got < want && poll(&pfd, 1, 2000) == 1) {
+            const ssize_t n = read(fd, reply + got, want - got);
+            if (n <= 0) {
+                break;
+            }
+            got += (size_t)n;
+        }
+    }
+    close(fd);
+    return got;
+}
+
+//Sends a pipelined batch of 100 SETs and a GET to a server running the epoll or io_uring loop on another thread.
+//Returns 1 when every reply came back right, 0 when not, and -1 when the loop could not start at all.
+static int test_server_batch(ht_hash_table* ht, const int uring) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_hash_table.%d.sock", (int)getpid());
+    test_server_thread t = {ht_server_new(ht), uring, 0};
+    if (ht_server_listen_unix(t.server, path, ht_binary_process) != 0) {
+        ht_server_free(t.server);
+        return 0;
+    }
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_server_main, &t);
+    ht_buf req = {NULL, 0, 0};
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        test_request(&req, HT_OP_SET, key, key);
+    }
+    test_request(&req, HT_OP_GET, "k42", NULL);
+    const size_t want = 101 * sizeof(ht_response_header) + 3;
+    char reply[101 * sizeof(ht_response_header) + 3];
+    const size_t got = test_exchange(path, &req, reply, want);
+    ht_server_stop(t.server);
+    pthread_join(thread, NULL);
+    ht_server_free(t.server);
+    unlink(path);
+    ht_buf_free(&req);
+    if (t.result < 0 && got == 0) {
+        return -1;
+    }
+    return got == want && memcmp(reply + want - 3, "k42", 3) == 0;
+}
+
+//the binary protocol parser on its own, then a pipelined batch over a Unix socket to a running server
+static void test_server(void) {
+    ht_hash_table* ht = ht_new();
+    ht_buf in = {NULL, 0, 0};
+    ht_buf out = {NULL, 0, 0};
+    test_request(&in, HT_OP_SET, "k", "v1");
+    test_request(&in, HT_OP_GET, "k", NULL);
+    test_request(&in, HT_OP_DEL, "k", NULL);
+    test_request(&in, HT_OP_DEL, "k", NULL);
+    const size_t whole = in.len;
+    test_request(&in, HT_OP_GET, "partial", NULL);
+    TEST_CHECK(ht_binary_process(ht, in.data, in.len - 2, &out) == (long)whole); //the torn request waits
+    ht_response_header r;
+    const uint8_t expected[] = {HT_STATUS_OK, HT_STATUS_OK, HT_STATUS_OK, HT_STATUS_NOT_FOUND};
+    size_t at = 0;
+    for (int i = 0; i < 4; i++) {
+        memcpy(&r, out.data + at, sizeof(r));
+        TEST_CHECK(r.status == expected[i]);
+        at += sizeof(r) + r.value_len;
+        if (i == 1) {
+            TEST_CHECK(r.value_len == 2 && memcmp(out.data + at - 2, "v1", 2) == 0);
+        }
+    }
+    TEST_CHECK(at == out.len);
+    const ht_request_header bad = {99, 0, 0, 0};
+    TEST_CHECK(ht_binary_process(ht, (const char*)&bad, sizeof(bad), &out) != 0);
+    ht_buf_free(&in);
+    ht_buf_free(&out);
+
+    TEST_CHECK(test_server_batch(ht, 0) == 1);
+    TEST_CHECK(ht->count == 100);
+    ht_delete_hash_table(ht);
+}
+
+//Connects to the server at path with every other descriptor below a lowered limit taken, so the server cannot
+//accept, and sends a SET. The server must not burn CPU meanwhile, and must answer once a descriptor is free again.
+static void test_starved_set(const char* path, const char* key) {
+    struct rlimit saved;
+    getrlimit(RLIMIT_NOFILE, &saved);
+    const int lowest = open("/dev/null", O_RDONLY);
+    close(lowest);
+    struct rlimit low = {(rlim_t)lowest + 8, saved.rlim_max};
+    setrlimit(RLIMIT_NOFILE, &low);
+    int filler[8];
+    int filled = 0;
+    while (filled < 8 && (filler[filled] = open("/dev/null", O_RDONLY)) >= 0) {
+        filled++;
+    }
+    close(filler[--filled]); //for the client's socket
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strcpy(addr.sun_path, path);
+    TEST_CHECK(fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    ht_buf req = {NULL, 0, 0};
+    test_request(&req, HT_OP_SET, key, "v");
+    TEST_CHECK(write(fd, req.data, req.len) == (ssize_t)req.len);
+    struct timespec cpu_before;
+    struct timespec cpu_after;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_before);
+    usleep(300000);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_after);
+    const long cpu_ms =
+        (cpu_after.tv_sec - cpu_before.tv_sec) * 1000 + (cpu_after.tv_nsec - cpu_before.tv_nsec) / 1000000;
+    TEST_CHECK(cpu_ms < 100); //a spinning loop burns all of the 300ms
+    close(filler[--filled]);
+    ht_response_header r = {HT_STATUS_ERROR, {0}, 0};
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    TEST_CHECK(poll(&pfd, 1, 2000) == 1 && read(fd, &r, sizeof(r)) == (ssize_t)sizeof(r));
+    TEST_CHECK(r.status == HT_STATUS_OK);
+    close(fd);
+    while (filled > 0) {
+        close(filler[--filled]);
+    }
+    setrlimit(RLIMIT_NOFILE, &saved);
+    ht_buf_free(&req);
+}
+
+//a server out of file descriptors stops trying to accept until one is likely free again, with the epoll or the
+//io_uring loop
+static void test_server_fd_limit(const int uring) {
+    ht_hash_table* ht = ht_new();
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_hash_table.%d.limit.sock", (int)getpid());
+    test_server_thread t = {ht_server_new(ht), uring, 0};
+    TEST_CHECK(ht_server_listen_unix(t.server, path, ht_binary_process) == 0);
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_server_main, &t);
+    //the loop must be serving, and so have the descriptors it sets up for itself, before they run out
+    ht_buf req = {NULL, 0, 0};
+    test_request(&req, HT_OP_GET, "limit", NULL);
+    ht_response_header r;
+    TEST_CHECK(test_exchange(path, &req, (char*)&r, sizeof(r)) == sizeof(r) && r.status == HT_STATUS_NOT_FOUND);
+    ht_buf_free(&req);
+    test_starved_set(path, "limit");
+    ht_server_stop(t.server);
+    pthread_join(thread, NULL);
+    ht_server_free(t.server);
+    TEST_CHECK(test_value_is(ht, "limit", "v"));
+    ht_delete_hash_table(ht);
+}
+
+//the same batch through the io_uring loop, skipped where the kernel or a sandbox does not allow io_uring
+static void test_server_uring(void) {
+    ht_hash_table* ht = ht_new();
+    const int result = test_server_batch(ht, 1);
+    if (result < 0) {
+        printf("io_uring unavailable, test_server_uring skipped\n");
+    } else {
+        TEST_CHECK(result == 1);
+        TEST_CHECK(ht->count == 100);
+        test_server_fd_limit(1);
+    }
+    ht_delete_hash_table(ht);
+}
+
+
+//runs in through the memcached protocol, checks what it consumed and answered, and clears out for the next call
+static void test_mc(ht_hash_table* ht, ht_buf* out, const char* in, const size_t len, const long used,
+                    const char* response, const size_t response_len, const int line) {
+    char* copy = malloc(len > 0 ? len : 1); //exactly len bytes, so a read past the end shows up under ASan
+    memcpy(copy, in, len);
+    const long got = ht_memcache_process(ht, copy, len, out);
+    free(copy);
+    if (got != used || out->len != response_len || memcmp(out->data, response, response_len) != 0) {
+        fprintf(stderr, "%s:%d: memcached exchange failed: consumed %ld of %zu, %zu bytes out\n", __FILE__, line,
+                got, len, out->len);
+        failures++;
+    }
+    out->len = 0;
+}
+
+static void test_memcache_text(void) {
+    ht_hash_table* ht = ht_new();
+    ht_buf out = {NULL, 0, 0};
+    const char set_get[] = "set a 0 0 5\r\nhello\r\nget a b\r\n";
+    const char reply[] = "STORED\r\nVALUE a 0 5\r\nhello\r\nEND\r\n";
+    test_mc(ht, &out, set_get, sizeof(set_get) - 1, sizeof(set_get) - 1, reply, sizeof(reply) - 1, __LINE__);
+    test_mc(ht, &out, "get a", 5, 0, "", 0, __LINE__); //no newline yet
+    test_mc(ht, &out, "set b 0 0 5\r\nhel", 16, 0, "", 0, __LINE__); //data block not all there
+    test_mc(ht, &out, "gets a\r\n", 8, 8, "VALUE a 0 5 0\r\nhello\r\nEND\r\n", 27, __LINE__);
+    test_mc(ht, &out, "delete a\r\n", 10, 10, "DELETED\r\n", 9, __LINE__);
+    test_mc(ht, &out, "delete a\r\n", 10, 10, "NOT_FOUND\r\n", 11, __LINE__);
+    test_mc(ht, &out, "set c 0 0 1 noreply\r\nx\r\n", 24, 24, "", 0, __LINE__);
+    TEST_CHECK(test_value_is(ht, "c", "x"));
+    test_mc(ht, &out, "bogus\r\n", 7, 7, "ERROR\r\n", 7, __LINE__);
+    test_mc(ht, &out, "set d 0 0 x\r\n", 13, 13, "CLIENT_ERROR bad command line format\r\n", 38, __LINE__);
+    test_mc(ht, &out, "set t 0 1 1\r\ny\r\n", 16, 16, "STORED\r\n", 8, __LINE__);
+    test_advance(ht, 2000);
+    test_mc(ht, &out, "get t\r\n", 7, 7, "END\r\n", 5, __LINE__);
+    test_mc(ht, &out, "quit\r\n", 6, -1, "", 0, __LINE__);
+    ht_buf_free(&out);
+    ht_delete_hash_table(ht);
+}
+
+//a binary request with a zero opaque and CAS, returns its length
+static size_t test_mc_request(char* buf, const uint8_t opcode, const char* key, const uint8_t extras_len,
+                              const char* value) {
+    const size_t key_len = strlen(key);
+    const size_t value_len = value != NULL ? strlen(value) : 0;
+    const size_t body = extras_len + key_len + value_len;
+    memset(buf, 0, 24 + extras_len);
+    buf[0] = (char)0x80;
+    buf[1] = (char)opcode;
+    buf[2] = (char)(key_len >> 8);
+    buf[3] = (char)key_len;
+    buf[4] = (char)extras_len;
+    buf[8] = (char)(body >> 24);
+    buf[9] = (char)(body >> 16);
+    buf[10] = (char)(body >> 8);
+    buf[11] = (char)body;
+    memcpy(buf + 24 + extras_len, key, key_len);
+    if (value_len > 0) {
+        memcpy(buf + 24 + extras_len + key_len, value, value_len);
+    }
+    return 24 + body;
+}
+
+//a binary response header with no key, as the table sends for everything but GETK
+static size_t test_mc_response(char* buf, const uint8_t opcode, const uint16_t status, const uint8_t extras_len,
+                               const char* value) {
+    const size_t value_len = value != NULL ? strlen(value) : 0;
+    const size_t body = extras_len + value_len;
+    memset(buf, 0, 24 + extras_len);
+    buf[0] = (char)0x81;
+    buf[1] = (char)opcode;
+    buf[4] = (char)extras_len;
+    buf[6] = (char)(status >> 8);
+    buf[7] = (char)status;
+    buf[11] = (char)body;
+    if (value_len > 0) {
+        memcpy(buf + 24 + extras_len, value, value_len);
+    }
+    return 24 + body;
+}
+
+static void test_memcache_binary(void) {
+    ht_hash_table* ht = ht_new();
+    ht_buf out = {NULL, 0, 0};
+    char request[256];
+    char response[256];
+    size_t len = test_mc_request(request, 0x01, "bk", 8, "bv"); //SET
+    size_t response_len = test_mc_response(response, 0x01, 0, 0, NULL);
+    test_mc(ht, &out, request, len, (long)len, response, response_len, __LINE__);
+    TEST_CHECK(test_value_is(ht, "bk", "bv"));
+
+    len = test_mc_request(request, 0x00, "bk", 0, NULL); //GET
+    response_len = test_mc_response(response, 0x00, 0, 4, "bv");
+    test_mc(ht, &out, request, len, (long)len, response, response_len, __LINE__);
+    //a lone magic byte after a complete GET is left for the next read, not peeked past
+    request[len] = (char)0x80;
+    test_mc(ht, &out, request, len + 1, (long)len, response, response_len, __LINE__);
+    test_mc(ht, &out, request, len - 1, 0, "", 0, __LINE__);
+
+    len = test_mc_request(request, 0x04, "bk", 0, NULL); //DELETE
+    response_len = test_mc_response(response, 0x04, 0, 0, NULL);
+    test_mc(ht, &out, request, len, (long)len, response, response_len, __LINE__);
+    len = test_mc_request(request, 0x00, "bk", 0, NULL);
+    response_len = test_mc_response(response, 0x00, 1, 0, "Not found");
+    test_mc(ht, &out, request, len, (long)len, response, response_len, __LINE__);
+    len = test_mc_request(request, 0x09, "bk", 0, NULL); //GETQ of a missing key says nothing
+    test_mc(ht, &out, request, len, (long)len, "", 0, __LINE__);
+    len = test_mc_request(request, 0x07, "", 0, NULL); //QUIT
+    test_mc(ht, &out, request, len, -1, "", 0, __LINE__);
+    ht_buf_free(&out);
+    ht_delete_hash_table(ht);
+}
+
+static void* test_shards_main(void* server) {
+    ht_shard_server_run(server);
+    return NULL;
+}
+
+//SETs then GETs of keys spread over every shard in one pipeline, the replies must come back in request order
+static void test_shards(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_hash_table.%d.sock", (int)getpid());
+    ht_shard_server* server = ht_shard_server_new(4);
+    TEST_CHECK(ht_shard_server_cores(server) == 4);
+    TEST_CHECK(ht_shard_server_listen_unix(server, path) == 0);
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_shards_main, server);
+    ht_buf req = {NULL, 0, 0};
+    ht_buf expected = {NULL, 0, 0};
+    char key[32];
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        test_request(&req, HT_OP_SET, key, key);
+        const ht_response_header ok = {HT_STATUS_OK, {0}, 0};
+        ht_buf_append(&expected, &ok, sizeof(ok));
+    }
+    for (int i = 0; i < 500; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        test_request(&req, HT_OP_GET, key, NULL);
+        const ht_response_header found = {HT_STATUS_OK, {0}, (uint32_t)strlen(key)};
+        ht_buf_append(&expected, &found, sizeof(found));
+        ht_buf_append(&expected, key, strlen(key));
+    }
+    test_request(&req, HT_OP_DEL, "absent", NULL);
+    const ht_response_header missing = {HT_STATUS_NOT_FOUND, {0}, 0};
+    ht_buf_append(&expected, &missing, sizeof(missing));
+    char* reply = malloc(expected.len);
+    TEST_CHECK(test_exchange(path, &req, reply, expected.len) == expected.len);
+    TEST_CHECK(memcmp(reply, expected.data, expected.len) == 0);
+    free(reply);
+    ht_shard_server_stop(server);
+    pthread_join(thread, NULL);
+    ht_shard_server_free(server);
+    unlink(path);
+    ht_buf_free(&req);
+    ht_buf_free(&expected);
+}
+
+//core 0 of a sharded server out of file descriptors stops watching the listener the same way
+static void test_shards_fd_limit(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/test_hash_table.%d.limit.sock", (int)getpid());
+    ht_shard_server* server = ht_shard_server_new(2);
+    TEST_CHECK(ht_shard_server_listen_unix(server, path) == 0);
+    pthread_t thread;
+    pthread_create(&thread, NULL, test_shards_main, server);
+    test_starved_set(path, "limit");
+    ht_shard_server_stop(server);
+    pthread_join(thread, NULL);
+    ht_shard_server_free(server);
+}
+
+//distinct count, count-min estimates and heavy hitters of the keys inserted into a table
+static void test_sketches(void) {
+    ht_hash_table* ht = ht_new();
+    ht_key_sketch* sketch = ht_key_sketch_new(14, 4096, 8);
+    ht_set_key_sketch(ht, sketch);
+    char key[32];
+    const int distinct = 20000;
+    for (int i = 0; i < distinct; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ht_insert(ht, key, "v");
+    }
+    for (int round = 0; round < 1000; round++) {
+        for (int h = 0; h < 4; h++) {
+            snprintf(key, sizeof(key), "hot%d", h);
+            ht_insert(ht, key, "v");
+        }
+    }
+    const double estimate = ht_key_sketch_distinct(sketch);
+    TEST_CHECK(estimate > (distinct + 4) * 0.95 && estimate < (distinct + 4) * 1.05);
+    const char* keys[8];
+    uint32_t counts[8];
+    const int n = ht_key_sketch_top(sketch, keys, counts, 8);
+    TEST_CHECK(n == 8);
+    int hot = 0;
+    for (int i = 0; i < n; i++) {
+        if (strncmp(keys[i], "hot", 3) == 0) {
+            hot++;
+            TEST_CHECK(counts[i] >= 1000);
+        }
+    }
+    TEST_CHECK(hot == 4);
+    ht_delete_hash_table(ht);
+    ht_key_sketch_free(sketch);
+}
+
+//The error of the count-min sketch on its own over a skewed stream: key i is counted 1 + 2000 / (i + 1) times, the
+//counts never come out low and none is more than 2 / width of the total high. Rows that shared a cache line, or
+//were all derived from one pair of hash values, overestimated some keys by several times that.
+static void test_count_error(void) {
+    const size_t width = 4096;
+    const int keys = 20000;
+    ht_count_sketch cm;
+    ht_count_init(&cm, width);
+    long total = 0;
+    for (int round = 0; round <= 2000; round++) {
+        for (int i = 0; i < keys && round <= 2000 / (i + 1); i++) {
+            ht_count_add(&cm, (uint64_t)i * 0x9e3779b97f4a7c15ULL);
+            total++;
+        }
+    }
+    int under = 0;
+    long worst = 0;
+    for (int i = 0; i < keys; i++) {
+        const long over = (long)ht_count_estimate(&cm, (uint64_t)i * 0x9e3779b97f4a7c15ULL) - (1 + 2000 / (i + 1));
+        under += over < 0;
+        worst = over > worst ? over : worst;
+    }
+    TEST_CHECK(under == 0);
+    TEST_CHECK(worst <= total * 2 / (long)width);
+    ht_count_free(&cm);
+}
+
+//deleted keys drop out of the filter once it is rebuilt, and no live key is ever rejected
+static void test_filter(void) {
+    ht_hash_table* ht = ht_new();
+    ht_set_filter(ht, 1);
+    char key[32];
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        ht_insert(ht, key, "v");
+    }
+    for (int i = 0; i < TEST_KEYS; i++) {
+        if (i % 10 != 0) {
+            snprintf(key, sizeof(key), "key%d", i);
+            ht_delete(ht, key);
+        }
+    }
+    ht_statistics before;
+    ht_stats(ht, &before);
+    int missing = 0;
+    int found = 0;
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        if (i % 10 == 0) {
+            missing += ht_search(ht, key) == NULL;
+        } else {
+            found += ht_search(ht, key) != NULL;
+        }
+    }
+    ht_statistics after;
+    ht_stats(ht, &after);
+    TEST_CHECK(missing == 0);
+    TEST_CHECK(found == 0);
+    //with 12 bits per key about 1 in 300 gets through, a filter still holding the deleted keys would reject none
+    TEST_CHECK(after.filter_rejects - before.filter_rejects > (unsigned long)(TEST_KEYS - TEST_KEYS / 10) * 9 / 10);
+    ht_delete_hash_table(ht);
+}
+
+//heap and mapped slot arrays both come back zeroed and 64 byte aligned
+static void test_slots(void) {
+    const size_t counts[] = {53, (size_t)1 << 20};
+    for (int c = 0; c < 2; c++) {
+        ht_item** slots = ht_slots_alloc(counts[c]);
+        TEST_CHECK(((uintptr_t)slots & 63) == 0);
+        int dirty = 0;
+        for (size_t i = 0; i < counts[c]; i++) {
+            dirty += slots[i] != NULL;
+        }
+        TEST_CHECK(dirty == 0);
+        const size_t page = ht_slots_page_size(slots);
+        TEST_CHECK(c == 0 ? page == 4096 : (page == 4096 || page == (size_t)2 << 20 || page == (size_t)1 << 30));
+        slots[counts[c] - 1] = (ht_item*)slots;
+        ht_slots_free(slots);
+    }
+}
+
+typedef struct {
+    ht_replicated* r;
+    int stop;
+    int bad;
+} test_replica_reader;
+
+//reads the keys every writer round leaves in place until told to stop
+static void* test_replica_read(void* arg) {
+    test_replica_reader* reader = arg;
+    char value[32];
+    while (!__atomic_load_n(&reader->stop, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < 100; i++) {
+            char key[32];
+            snprintf(key, sizeof(key), "k%d", i);
+            if (ht_replicated_search(reader->r, key, value, sizeof(value)) != (long)strlen(key) ||
+                strcmp(value, key) != 0) {
+                reader->bad++;
+            }
+        }
+    }
+    return NULL;
+}
+
+//writes reach every replica, truncated copies are terminated, and readers never see a torn value
+static void test_replicas(void) {
+    ht_replicated* r = ht_replicated_new();
+    const int replicas = ht_replicated_replicas(r);
+    TEST_CHECK(replicas >= 1);
+    char key[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ht_replicated_insert(r, key, key);
+    }
+    int nodes[HT_NUMA_MAX_NODES];
+    const int count = ht_numa_nodes(nodes, HT_NUMA_MAX_NODES);
+    for (int i = 0; i < count; i++) {
+        TEST_CHECK(ht_replicated_table(r, nodes[i])->count == 100);
+    }
+    char small[3];
+    TEST_CHECK(ht_replicated_search(r, "k42", small, sizeof(small)) == 3 && strcmp(small, "k4") == 0);
+    TEST_CHECK(ht_replicated_search(r, "absent", small, sizeof(small)) == -1);
+
+    test_replica_reader readers[2];
+    pthread_t threads[2];
+    for (int t = 0; t < 2; t++) {
+        readers[t] = (test_replica_reader){r, 0, 0};
+        pthread_create(&threads[t], NULL, test_replica_read, &readers[t]);
+    }
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "w%d", i);
+        ht_replicated_insert(r, key, "v");
+        if (i % 2 == 0) {
+            TEST_CHECK(ht_replicated_delete(r, key) == 1);
+        }
+    }
+    for (int t = 0; t < 2; t++) {
+        __atomic_store_n(&readers[t].stop, 1, __ATOMIC_RELEASE);
+        pthread_join(threads[t], NULL);
+        TEST_CHECK(readers[t].bad == 0);
+    }
+    TEST_CHECK(ht_replicated_table(r, nodes[0])->count == 100 + TEST_KEYS / 2);
+    ht_replicated_free(r);
+}
+
+//a presized table takes its keys without resizing, prefaulted or not, and a huge reservation only maps address space
+static void test_reserve(void) {
+    ht_thread_pool* pool = ht_pool_new(4);
+    for (int prefault = 0; prefault < 3; prefault++) {
+        ht_hash_table* ht = ht_new();
+        ht_reserve(ht, 100000);
+        const int size = ht->size;
+        TEST_CHECK(size >= 100000 * 100 / 70);
+        if (prefault > 0) {
+            ht_prefault(ht, prefault == 2 ? pool : NULL);
+        }
+        char key[32];
+        for (int i = 0; i < 100000; i++) {
+            snprintf(key, sizeof(key), "k%d", i);
+            ht_insert(ht, key, "v");
+        }
+        TEST_CHECK(ht->size == size);
+        TEST_CHECK(test_value_is(ht, "k99999", "v"));
+        ht_delete_hash_table(ht);
+    }
+    ht_pool_free(pool);
+
+    //a reserved table emptied again keeps its size for the next load, until ht_shrink_to_fit gives it up
+    ht_hash_table* reserved = ht_new();
+    ht_reserve(reserved, 100000);
+    const int reserved_size = reserved->size;
+    ht_insert(reserved, "k", "v");
+    ht_delete(reserved, "k");
+    ht_delete(reserved, "none");
+    TEST_CHECK(reserved->size == reserved_size);
+    ht_shrink_to_fit(reserved);
+    TEST_CHECK(reserved->size < reserved_size);
+    ht_delete_hash_table(reserved);
+    //one grown past its reservation shrinks back down to it and no further
+    reserved = ht_new();
+    ht_reserve(reserved, 1000);
+    const int small_size = reserved->size;
+    char key[32];
+    for (int i = 0; i < TEST_KEYS * 4; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ht_insert(reserved, key, "v");
+    }
+    TEST_CHECK(reserved->size > small_size);
+    for (int i = 0; i < TEST_KEYS * 4; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        ht_delete(reserved, key);
+    }
+    TEST_CHECK(reserved->size == small_size && reserved->count == 0);
+    ht_delete_hash_table(reserved);
+
+    ht_hash_table* huge = ht_new();
+    ht_reserve(huge, 100000000);
+    TEST_CHECK(huge->size > 100000000);
+    ht_insert(huge, "k", "v");
+    TEST_CHECK(test_value_is(huge, "k", "v") && ht_search(huge, "none") == NULL);
+    ht_delete_hash_table(huge);
+}
+
+//a spike of keys, most of them deleted again, then shrunk with TTL items both due and not
+static void test_shrink_table(void) {
+    ht_hash_table* ht = ht_new();
+    char key[32];
+    char value[32];
+    for (int i = 0; i < TEST_KEYS; i++) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        ht_insert(ht, key, value);
+    }
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "due%d", i);
+        ht_insert_ttl(ht, key, "soon", 1);
+        snprintf(key, sizeof(key), "later%d", i);
+        ht_insert_ttl(ht, key, "later", 3600);
+    }
+    for (int i = 0; i < TEST_KEYS; i++) {
+        if (i % 10 != 0) {
+            snprintf(key, sizeof(key), "key%d", i);
+            ht_delete(ht, key);
+        }
+    }
+    const int size_before = ht->size;
+    test_advance(ht, 2000);
+    ht_shrink_to_fit(ht);
+    TEST_CHECK(ht->count == TEST_KEYS / 10 + 100);
+    TEST_CHECK(ht->size < size_before);
+    TEST_CHECK(ht->tombstones == 0);
+    int bad = 0;
+    for (int i = 0; i < TEST_KEYS; i += 10) {
+        snprintf(key, sizeof(key), "key%d", i);
+        snprintf(value, sizeof(value), "value%d", i);
+        bad += !test_value_is(ht, key, value);
+    }
+    for (int i = 0; i < 100; i++) {
+        snprintf(key, sizeof(key), "due%d", i);
+        bad += ht_search(ht, key) != NULL;
+        snprintf(key, sizeof(key), "later%d", i);
+        bad += !test_value_is(ht, key, "later");
+    }
+    TEST_CHECK(bad == 0);
+    //packed items and strings must survive being overwritten, deleted and packed again
+    ht_insert(ht, "key0", "replaced");
+    TEST_CHECK(ht_delete(ht, "key10") == 1);
+    ht_shrink_to_fit(ht);
+    TEST_CHECK(test_value_is(ht, "key0", "replaced"));
+    TEST_CHECK(ht_search(ht, "key10") == NULL);
+    test_advance(ht, 3600 * 1000);
+    TEST_CHECK(ht_expire(ht, 1000) == 100);
+    TEST_CHECK(ht->count == TEST_KEYS / 10 - 1);
+    ht_delete_hash_table(ht);
+}
+
+//cache entries embed their items, ht_shrink_to_fit must leave them where they are
+static void test_shrink_cache(void) {
+    ht_cache* cache = ht_cache_new(HT_CACHE_LRU, 1000, 0, NULL, NULL);
+    char key[32];
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, sizeof(key), "entry%d", i);
+        ht_cache_put(cache, key, "first");
+    }
+    TEST_CHECK(cache->table->count == 1000);
+    TEST_CHECK(cache->evictions == 1000);
+    ht_shrink_to_fit(cache->table);
+    int bad = 0;
+    for (int i = 1000; i < 2000; i++) {
+        snprintf(key, sizeof(key), "entry%d", i);
+        const char* value = ht_cache_get(cache, key);
+        bad += value == NULL || strcmp(value, "first") != 0;
+        ht_cache_put(cache, key, "second");
+    }
+    TEST_CHECK(bad == 0);
+    TEST_CHECK(strcmp(ht_cache_get(cache, "entry1500"), "second") == 0);
+    ht_cache_remove(cache, "entry1500");
+    TEST_CHECK(ht_cache_get(cache, "entry1500") == NULL);
+    ht_cache_free(cache);
+}
+
+int main(void) {
+    test_basic(HT_LAYOUT_OPEN);
+    test_basic(HT_LAYOUT_CUCKOO);
+    test_basic(HT_LAYOUT_HOPSCOTCH);
+    test_stats();
+    test_instrument();
+    test_seeded();
+    test_flood();
+    test_cache();
+    test_cache_admission();
+    test_ttl();
+    test_iter(HT_LAYOUT_OPEN);
+    test_iter(HT_LAYOUT_CUCKOO);
+    test_iter(HT_LAYOUT_HOPSCOTCH);
+    test_parallel();
+    test_parallel_resize();
+    test_upsert(HT_LAYOUT_OPEN);
+    test_upsert(HT_LAYOUT_CUCKOO);
+    test_upsert(HT_LAYOUT_HOPSCOTCH);
+    test_borrowed();
+    test_intern();
+    test_server();
+    test_server_fd_limit(0);
+    test_server_uring();
+    test_memcache_text();
+    test_memcache_binary();
+    test_shards();
+    test_shards_fd_limit();
+    test_sketches();
+    test_count_error();
+    test_filter();
+    test_slots();
+    test_replicas();
+    test_reserve();
+    test_shrink_table();
+    test_shrink_cache();
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
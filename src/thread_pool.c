@@ -0,0 +1,218 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "hash_table_internal.h"
+#include "thread_pool.h"
+
+//The chunks a worker still owns, [first, last) packed into one word so the owner taking from the front and a thief
+//taking from the back agree through a single compare and swap. One per cache line, owners never share a line.
+typedef struct {
+    _Alignas(HT_CACHE_LINE) uint64_t range;
+} ht_pool_share;
+
+struct ht_thread_pool {
+    int threads;
+    pthread_t* workers; //threads - 1 of them, the caller of ht_pool_run is worker 0
+    ht_pool_share* shares;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation; //bumped by every ht_pool_run, workers wait for it to change
+    int running; //workers still busy with the current generation
+    int stopping;
+    //the current job
+    ht_pool_fn fn;
+    void* ctx;
+    size_t n;
+    size_t grain;
+};
+
+typedef struct {
+    ht_thread_pool* pool;
+    int worker;
+} ht_pool_worker_arg;
+
+static uint64_t ht_pool_pack(const uint32_t first, const uint32_t last) {
+    return ((uint64_t)last << 32) | first;
+}
+
+//takes the next chunk from the front of the worker's own share, returns 0 once it is empty
+static int ht_pool_take(ht_pool_share* share, uint32_t* chunk) {
+    uint64_t range = __atomic_load_n(&share->range, __ATOMIC_ACQUIRE);
+    for (;;) {
+        const uint32_t first = (uint32_t)range;
+        const uint32_t last = (uint32_t)(range >> 32);
+        if (first >= last) {
+            return 0;
+        }
+        if (__atomic_compare_exchange_n(&share->range, &range, ht_pool_pack(first + 1, last), 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            *chunk = first;
+            return 1;
+        }
+    }
+}
+
+//Moves the back half of the fullest other share into the thief's own, returns 0 when there is nothing left anywhere.
+static int ht_pool_steal(ht_thread_pool* pool, const int thief) {
+    for (;;) {
+        int victim = -1;
+        uint32_t most = 0;
+        uint64_t range = 0;
+        for (int w = 0; w < pool->threads; w++) {
+            const uint64_t r = __atomic_load_n(&pool->shares[w].range, __ATOMIC_ACQUIRE);
+            const uint32_t left = (uint32_t)(r >> 32) - (uint32_t)r;
+            if (w != thief && (uint32_t)r < (uint32_t)(r >> 32) && left > most) {
+                victim = w;
+                most = left;
+                range = r;
+            }
+        }
+        if (victim < 0) {
+            return 0;
+        }
+        const uint32_t first = (uint32_t)range;
+        const uint32_t last = (uint32_t)(range >> 32);
+        const uint32_t split = last - (most + 1) / 2;
+        if (__atomic_compare_exchange_n(&pool->shares[victim].range, &range, ht_pool_pack(first, split), 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            //only the owner refills its share and it is empty, so a plain store cannot clobber anything
+            __atomic_store_n(&pool->shares[thief].range, ht_pool_pack(split, last), __ATOMIC_RELEASE);
+            return 1;
+        }
+    }
+}
+
+static void ht_pool_work(ht_thread_pool* pool, const int worker) {
+    uint32_t chunk;
+    do {
+        while (ht_pool_take(&pool->shares[worker], &chunk)) {
+            const size_t begin = (size_t)chunk * pool->grain;
+            const size_t end = begin + pool->grain < pool->n ? begin + pool->grain : pool->n;
+            pool->fn(pool->ctx, begin, end, worker);
+        }
+    } while (ht_pool_steal(pool, worker));
+}
+
+static void* ht_pool_main(void* arg) {
+    ht_pool_worker_arg* a = arg;
+    ht_thread_pool* pool = a->pool;
+    const int worker = a->worker;
+    free(a);
+    unsigned long seen = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->stopping) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->stopping) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        ht_pool_work(pool, worker);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ht_thread_pool* ht_pool_new(int threads) {
+    if (threads <= 0) {
+        const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int)cpus : 1;
+    }
+    ht_thread_pool* pool = ht_calloc(1, sizeof(ht_thread_pool));
+    pool->shares = ht_aligned_alloc(HT_CACHE_LINE, sizeof(ht_pool_share) * (size_t)threads);
+    pool->workers = ht_malloc(sizeof(pthread_t) * (size_t)threads);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->threads = 1;
+    for (int w = 1; w < threads; w++) {
+        ht_pool_worker_arg* arg = ht_malloc(sizeof(ht_pool_worker_arg));
+        arg->pool = pool;
+        arg->worker = w;
+        if (pthread_create(&pool->workers[w - 1], NULL, ht_pool_main, arg) != 0) {
+            free(arg);
+            break; //run with however many threads we got
+        }
+        pool->threads++;
+    }
+    return pool;
+}
+
+void ht_pool_free(ht_thread_pool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int w = 1; w < pool->threads; w++) {
+        pthread_join(pool->workers[w - 1], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->workers);
+    free(pool->shares);
+    free(pool);
+}
+
+int ht_pool_threads(const ht_thread_pool* pool) {
+    return pool->threads;
+}
+
+void ht_pool_run(ht_thread_pool* pool, const size_t n, size_t grain, ht_pool_fn fn, void* ctx) {
+    if (n == 0) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+    if ((n + grain - 1) / grain > UINT32_MAX) {
+        grain = (n + UINT32_MAX - 1) / UINT32_MAX;
+    }
+    const uint32_t chunks = (uint32_t)((n + grain - 1) / grain);
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->n = n;
+    pool->grain = grain;
+    for (int w = 0; w < pool->threads; w++) {
+        const uint32_t first = (uint32_t)((uint64_t)chunks * (uint64_t)w / (uint64_t)pool->threads);
+        const uint32_t last = (uint32_t)((uint64_t)chunks * (uint64_t)(w + 1) / (uint64_t)pool->threads);
+        pool->shares[w].range = ht_pool_pack(first, last);
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->generation++;
+    pool->running = pool->threads - 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    ht_pool_work(pool, 0);
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
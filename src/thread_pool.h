@@ -0,0 +1,42 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+//A fixed set of worker threads that run data parallel loops over an index range.
+//The range is cut into chunks and every worker starts on its own contiguous share of them, taking chunks from the
+//front. A worker that runs out steals the back half of the largest remaining share, so uneven chunks (a slot array
+//with dense and sparse stretches, say) still keep every core busy until the end.
+
+#include <stddef.h>
+
+typedef struct ht_thread_pool ht_thread_pool;
+
+//runs over [begin, end), worker is in [0, ht_pool_threads()) and identifies the calling thread for per-thread state
+typedef void (*ht_pool_fn)(void* ctx, size_t begin, size_t end, int worker);
+
+//threads <= 0 uses one thread per online CPU, the thread calling ht_pool_run counts as one of them
+ht_thread_pool* ht_pool_new(int threads);
+void ht_pool_free(ht_thread_pool* pool);
+int ht_pool_threads(const ht_thread_pool* pool);
+
+//Calls fn over [0, n) in chunks of grain indices (the last one may be shorter) and returns once all are done.
+//Not reentrant: one ht_pool_run at a time per pool.
+void ht_pool_run(ht_thread_pool* pool, size_t n, size_t grain, ht_pool_fn fn, void* ctx);
+
+#endif
@@ -0,0 +1,165 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "hash_table_internal.h"
+#include "timer_wheel.h"
+
+#define HT_TTL_ITEM(l) ((ht_ttl_item*)((char*)(l) - offsetof(ht_ttl_item, link)))
+
+//coarse clock: a few nanoseconds per read, and a TTL measured in seconds does not need better than its few ms
+static uint64_t ht_timer_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void ht_timer_link_init(ht_timer_link* l) {
+    l->prev = l;
+    l->next = l;
+}
+
+static void ht_timer_link_add(ht_timer_link* head, ht_timer_link* l) {
+    l->prev = head->prev;
+    l->next = head;
+    head->prev->next = l;
+    head->prev = l;
+}
+
+//the second in which an item expiring at expires_ms is due, rounded up so it is never swept early
+static uint64_t ht_timer_tick_of(const uint64_t expires_ms) {
+    return (expires_ms + 999) / 1000;
+}
+
+//files the item under the coarsest level whose span still reaches its tick
+static void ht_timer_schedule(ht_timer_wheel* wheel, ht_ttl_item* t) {
+    uint64_t due = ht_timer_tick_of(t->expires_ms);
+    if (due < wheel->tick) {
+        due = wheel->tick; //already late, sweep it with the current slot
+    }
+    const uint64_t delta = due - wheel->tick;
+    int level = 0;
+    while (level < HT_WHEEL_LEVELS - 1 && delta >= (1ULL << (HT_WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    if (delta >= (1ULL << (HT_WHEEL_BITS * HT_WHEEL_LEVELS))) {
+        //past the wheel's span, park it in the last slot of the top level and let it cascade back down
+        due = wheel->tick + (1ULL << (HT_WHEEL_BITS * HT_WHEEL_LEVELS)) - 1;
+    }
+    const int slot = (int)((due >> (HT_WHEEL_BITS * level)) & (HT_WHEEL_SLOTS - 1));
+    ht_timer_link_add(&wheel->slots[level][slot], &t->link);
+}
+
+//on entering a tick where a level's index wraps, redistribute that level's slot; top level first so items
+//dropping from level 2 into level 1 are redistributed again in the same tick
+static void ht_timer_cascade(ht_timer_wheel* wheel) {
+    int top = 0;
+    while (top < HT_WHEEL_LEVELS - 1 && (wheel->tick & ((1ULL << (HT_WHEEL_BITS * (top + 1))) - 1)) == 0) {
+        top++;
+    }
+    for (int level = top; level >= 1; level--) {
+        ht_timer_link* head = &wheel->slots[level][(wheel->tick >> (HT_WHEEL_BITS * level)) & (HT_WHEEL_SLOTS - 1)];
+        ht_timer_link pending;
+        ht_timer_link_init(&pending);
+        if (head->next != head) {
+            //detach the whole list first, rescheduling may put items back into this very slot
+            pending.next = head->next;
+            pending.prev = head->prev;
+            pending.next->prev = &pending;
+            pending.prev->next = &pending;
+            ht_timer_link_init(head);
+        }
+        while (pending.next != &pending) {
+            ht_timer_link* l = pending.next;
+            pending.next = l->next;
+            l->next->prev = &pending;
+            ht_timer_schedule(wheel, HT_TTL_ITEM(l));
+        }
+    }
+}
+
+ht_timer_wheel* ht_timer_wheel_new(void) {
+    ht_timer_wheel* wheel = ht_malloc(sizeof(ht_timer_wheel));
+    wheel->start_ms = ht_timer_clock_ms();
+    wheel->tick = 0;
+    for (int level = 0; level < HT_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < HT_WHEEL_SLOTS; slot++) {
+            ht_timer_link_init(&wheel->slots[level][slot]);
+        }
+    }
+    return wheel;
+}
+
+//the items must already be gone, freeing them is what unlinks them from the slots
+void ht_timer_wheel_free(ht_timer_wheel* wheel) {
+    free(wheel);
+}
+
+//milliseconds since the wheel was created
+uint64_t ht_timer_now(const ht_timer_wheel* wheel) {
+    return ht_timer_clock_ms() - wheel->start_ms;
+}
+
+//builds an item that expires ttl_seconds from now and files it in the wheel
+ht_item* ht_timer_new_item(ht_timer_wheel* wheel, const char* key, const char* value, const int ttl_seconds) {
+    ht_ttl_item* t = ht_malloc(sizeof(ht_ttl_item));
+    t->item.key = ht_strdup(key);
+    t->item.value = ht_strdup(value);
+    t->item.flags = HT_ITEM_TTL;
+    t->expires_ms = ht_timer_now(wheel) + (uint64_t)(ttl_seconds > 0 ? ttl_seconds : 0) * 1000;
+    ht_timer_schedule(wheel, t);
+    return &t->item;
+}
+
+//called when a TTL item is freed, whether it expired, was deleted or was overwritten
+void ht_timer_unlink(ht_item* item) {
+    ht_ttl_item* t = (ht_ttl_item*)item;
+    t->link.prev->next = t->link.next;
+    t->link.next->prev = t->link.prev;
+    ht_timer_link_init(&t->link);
+}
+
+int ht_timer_expired(const ht_timer_wheel* wheel, const ht_item* item) {
+    return ((const ht_ttl_item*)item)->expires_ms <= ht_timer_now(wheel);
+}
+
+//Advances the wheel to the current second, deleting what has expired on the way but no more than max_items,
+//so a caller can bound the pause. Whatever is left over is picked up by the next call. Returns how many went.
+int ht_timer_advance(ht_hash_table* ht, const int max_items) {
+    ht_timer_wheel* wheel = ht->wheel;
+    const uint64_t target = ht_timer_now(wheel) / 1000;
+    int removed = 0;
+    for (;;) {
+        ht_timer_link* head = &wheel->slots[0][wheel->tick & (HT_WHEEL_SLOTS - 1)];
+        while (head->next != head) {
+            if (removed == max_items) {
+                return removed;
+            }
+            //ht_delete frees the item, which unlinks it from this slot
+            ht_delete(ht, HT_TTL_ITEM(head->next)->item.key);
+            removed++;
+        }
+        if (wheel->tick >= target) {
+            return removed;
+        }
+        wheel->tick++;
+        ht_timer_cascade(wheel);
+    }
+}
@@ -0,0 +1,59 @@
+/***********************************************
+* Project Title: Write a Hash Table in C
+* Author: Dawson Whipple
+* Date: 07/10/24
+* Description: A hash table is a data structure which offers a fast implementation of the associative array API.
+*              Associative arrays are a collection of unordered key-value pairs. Duplicate keys are not permitted. The following operations are supported:
+
+    search(a, k): return the value v associated with key k from the associative array a, or NULL if the key does not exist.
+    insert(a, k, v): store the pair k:v in the associative array a.
+    delete(a, k): delete the k:v pair associated with k, or do nothing if k does not exist.
+
+*********************************************/
+//https://github.com/jamesroutley/write-a-hash-table/tree/master/01-introduction
+//Associative array: an abstract data structure which implements the API described above. Also called a map, symbol table or dictionary.
+//Hash table: a fast implementation of the associative array API which makes use of a hash function. Also called a hash map, map, hash or dictionary.
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+//Hierarchical timer wheel tracking the expiry of items inserted with ht_insert_ttl.
+//Four levels of 64 slots with one second ticks cover about 194 days; an item goes into the slot of the coarsest
+//level it fits and drops a level each time that slot comes round, so adding, removing and expiring an item is O(1)
+//amortized and nothing ever scans the table.
+
+#include <stdint.h>
+
+#include "hash_table.h"
+
+#define HT_WHEEL_LEVELS 4
+#define HT_WHEEL_BITS 6
+#define HT_WHEEL_SLOTS (1 << HT_WHEEL_BITS)
+
+typedef struct ht_timer_link {
+    struct ht_timer_link* prev;
+    struct ht_timer_link* next;
+} ht_timer_link;
+
+//an ht_item with HT_ITEM_TTL set is really one of these
+typedef struct {
+    ht_item item; //first member, so the table handles it like any other item
+    ht_timer_link link; //position in the wheel slot it is waiting in
+    uint64_t expires_ms; //milliseconds since the wheel was created
+} ht_ttl_item;
+
+typedef struct ht_timer_wheel {
+    uint64_t start_ms; //monotonic clock when the wheel was created
+    uint64_t tick; //the second the wheel has been advanced to
+    ht_timer_link slots[HT_WHEEL_LEVELS][HT_WHEEL_SLOTS]; //circular lists with the slot as sentinel
+} ht_timer_wheel;
+
+ht_timer_wheel* ht_timer_wheel_new(void);
+void ht_timer_wheel_free(ht_timer_wheel* wheel);
+uint64_t ht_timer_now(const ht_timer_wheel* wheel);
+ht_item* ht_timer_new_item(ht_timer_wheel* wheel, const char* key, const char* value, const int ttl_seconds);
+void ht_timer_unlink(ht_item* item);
+int ht_timer_expired(const ht_timer_wheel* wheel, const ht_item* item);
+int ht_timer_advance(ht_hash_table* ht, const int max_items);
+
+#endif